@@ -0,0 +1,13 @@
+#!/bin/sh
+
+mkdir -p build
+cd build
+
+CompilerFlags="-O2 -g -std=c++17 -o rsc -Wno-write-strings"
+# Defines="-DBUILD_DEBUG -DOS_LINUX -DCOMPILER_GCC"
+Defines="-DOS_LINUX -DCOMPILER_GCC"
+Libs=""
+
+g++ $CompilerFlags $Defines ../src/*.cpp $Libs
+
+cd ..
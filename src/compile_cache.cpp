@@ -0,0 +1,188 @@
+#include "compile_cache.h"
+#include "hash_table.h"
+#include "os.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+CompileCache compileCache;
+
+static StringTable<Hash128> compilerIdentities;
+
+// The resolved compiler path plus its modtime and size: a compiler update
+// changes the identity and with it every key.
+Hash128 CompileCache::getCompilerIdentity(char *compiler) {
+    Hash128 *existing = compilerIdentities.find(compiler);
+    if (existing) return *existing;
+
+    HashBuilder builder;
+    builder.add(compiler);
+
+    char *path = os::findExecutable(compiler);
+    if (path) {
+        u64 modtime = 0;
+        u64 size = 0;
+        os::getFileInfo(path, &modtime, &size);
+        
+        builder.add(path);
+        builder.add(modtime);
+        builder.add(size);
+        free(path);
+    }
+
+    *compilerIdentities.add(copyString(compiler)) = builder.state;
+    return builder.state;
+}
+
+static char *getEntryDirectory(char *directory, Hash128 key) {
+    return mprintf("%s/%02x", directory, (unsigned)(key.high >> 56));
+}
+
+static char *getEntryPath(char *directory, Hash128 key, char *extension) {
+    return mprintf("%s/%02x/%016llx%016llx.%s", directory, (unsigned)(key.high >> 56),
+                   (unsigned long long)key.high, (unsigned long long)key.low, extension);
+}
+
+bool CompileCache::restore(Hash128 key, char *objectPath, char *extension) {
+    char *entryPath = getEntryPath(directory, key, extension);
+    defer { free(entryPath); };
+
+    if (!os::fileExists(entryPath) || !os::copyFile(entryPath, objectPath)) {
+        misses++;
+        return false;
+    }
+
+    // The restored object has to look freshly built to the staleness check,
+    // and the entry freshly used to trim().
+    os::touchFile(objectPath);
+    os::touchFile(entryPath);
+    
+    hits++;
+    return true;
+}
+
+// Written under a temporary name and renamed into place, so other builds
+// sharing the cache never see a half-written entry.
+static char *getTemporaryPath(char *entryPath, char *objectPath) {
+    u64 unique = hashString(objectPath) ^ (u64)(os::getTime() * 1000000000.0);
+    return mprintf("%s.%016llx.tmp", entryPath, (unsigned long long)unique);
+}
+
+void CompileCache::store(Hash128 key, char *objectPath, char *extension) {
+    char *entryDirectory = getEntryDirectory(directory, key);
+    defer { free(entryDirectory); };
+    os::makeDirectoryIfNotExist(entryDirectory);
+    
+    char *entryPath = getEntryPath(directory, key, extension);
+    defer { free(entryPath); };
+
+    char *temporaryPath = getTemporaryPath(entryPath, objectPath);
+    defer { free(temporaryPath); };
+    
+    if (!os::copyFile(objectPath, temporaryPath)) return;
+    if (!os::moveFile(temporaryPath, entryPath)) {
+        os::deleteFile(temporaryPath);
+        return;
+    }
+    
+    stores++;
+}
+
+bool CompileCache::loadManifest(Hash128 directKey, DynamicArray<char *> &paths) {
+    char *manifestPath = getEntryPath(directory, directKey, "deps");
+    defer { free(manifestPath); };
+
+    char *contents = (char *)os::readEntireFile(manifestPath);
+    if (!contents) return false;
+    defer { free(contents); };
+
+    char *cursor = contents;
+    while (char *line = consumeNextLine(&cursor)) {
+        if (line[0]) paths.add(copyString(line));
+    }
+    
+    os::touchFile(manifestPath);
+    return paths.count > 0;
+}
+
+void CompileCache::storeManifest(Hash128 directKey, char *objectPath, DynamicArray<char *> &paths) {
+    char *entryDirectory = getEntryDirectory(directory, directKey);
+    defer { free(entryDirectory); };
+    os::makeDirectoryIfNotExist(entryDirectory);
+    
+    char *manifestPath = getEntryPath(directory, directKey, "deps");
+    defer { free(manifestPath); };
+
+    StringBuilder builder;
+    for (int i = 0; i < paths.count; i++) {
+        builder.printf("%s\n", paths[i]);
+    }
+
+    char *temporaryPath = getTemporaryPath(manifestPath, objectPath);
+    defer { free(temporaryPath); };
+    
+    if (!os::writeEntireFile(temporaryPath, builder.buffer.data, builder.buffer.count)) return;
+    if (!os::moveFile(temporaryPath, manifestPath)) {
+        os::deleteFile(temporaryPath);
+    }
+}
+
+struct CacheEntry {
+    char *path;
+    u64 modtime;
+    u64 size;
+};
+
+static int compareCacheEntries(const void *a, const void *b) {
+    u64 modtimeA = ((CacheEntry *)a)->modtime;
+    u64 modtimeB = ((CacheEntry *)b)->modtime;
+    if (modtimeA < modtimeB) return -1;
+    if (modtimeA > modtimeB) return 1;
+    return 0;
+}
+
+void CompileCache::trim() {
+    if (!maxSize) return;
+
+    DynamicArray<CacheEntry> entries;
+    u64 totalSize = 0;
+
+    DynamicArray<os::DirectoryEntry> subdirectories;
+    os::listDirectory(directory, subdirectories);
+    for (int i = 0; i < subdirectories.count; i++) {
+        if (!subdirectories[i].isDirectory) continue;
+        
+        char *subdirectory = mprintf("%s/%s", directory, subdirectories[i].name);
+        defer { free(subdirectory); };
+
+        DynamicArray<os::DirectoryEntry> files;
+        os::listDirectory(subdirectory, files);
+        for (int j = 0; j < files.count; j++) {
+            if (files[j].isDirectory) continue;
+            
+            CacheEntry entry;
+            entry.path = mprintf("%s/%s", subdirectory, files[j].name);
+            entry.modtime = files[j].modtime;
+            entry.size = files[j].size;
+            if (!files[j].hasInfo) {
+                os::getFileInfo(entry.path, &entry.modtime, &entry.size);
+            }
+            
+            totalSize += entry.size;
+            entries.add(entry);
+        }
+    }
+
+    if (totalSize <= maxSize) return;
+
+    // Evict down to 90% so we don't end up trimming after every single store.
+    u64 targetSize = maxSize / 10 * 9;
+    qsort(entries.data, entries.count, sizeof(CacheEntry), compareCacheEntries);
+    for (int i = 0; i < entries.count && totalSize > targetSize; i++) {
+        if (os::deleteFile(entries[i].path)) {
+            totalSize -= entries[i].size;
+            evictions++;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "hash.h"
+
+// Local content-addressed cache of object files. The key of a compile is
+// the hash of everything that decides its output: the compiler binary, the
+// full command line and the contents of the source and every header it
+// includes. Entries are files named after their key in a two-level fanout
+// under the cache directory; their modtime is bumped on every hit so that
+// trim() can evict the least recently used ones.
+//
+// Which headers a compile reads is only known from what the compiler
+// reported once it ran, so the key is found in two steps. The direct key
+// (compiler, command line) names a manifest listing the files the last
+// stored compile read, and the contents of those files as they are now
+// complete the key.
+struct CompileCache {
+    char *directory = NULL;
+    u64 maxSize = 0;
+
+    int hits = 0;
+    int misses = 0;
+    int stores = 0;
+    int evictions = 0;
+
+    bool isEnabled() { return directory != NULL; }
+
+    Hash128 getCompilerIdentity(char *compiler);
+
+    // extension is the toolchain's object file extension, entries are named like objects.
+    bool restore(Hash128 key, char *objectPath, char *extension);
+    void store(Hash128 key, char *objectPath, char *extension);
+
+    // paths are allocated with copyString.
+    bool loadManifest(Hash128 directKey, DynamicArray<char *> &paths);
+    void storeManifest(Hash128 directKey, char *objectPath, DynamicArray<char *> &paths);
+
+    // Evicts least recently used entries until the cache fits in maxSize.
+    void trim();
+};
+
+extern CompileCache compileCache;
@@ -0,0 +1,158 @@
+#include "console.h"
+#include "os.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+Console console;
+
+char *mprintf_valist(char *fmt, va_list args);
+char *toCString(char *text, i32 textLength);
+
+void Console::write(char *data, i64 length) {
+    pending.reserve(pending.count + (int)length);
+    memcpy(pending.data + pending.count, data, length);
+    pending.count += (int)length;
+}
+
+void Console::printf(char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    char *buf = mprintf_valist(fmt, args);
+    va_end(args);
+    defer { free(buf); };
+
+    write(buf, getStringLength(buf));
+}
+
+static bool lineContains(char *line, i64 length, char *s) {
+    i64 sLength = getStringLength(s);
+    for (i64 i = 0; i + sLength <= length; i++) {
+        if (memcmp(line + i, s, sLength) == 0) return true;
+    }
+    return false;
+}
+
+struct OutputLine {
+    char *start;
+    i64 length; // Without the line break.
+    char *next;
+};
+
+// "file:line:" (gcc, clang) or "file(line)" (cl), where file may start
+// with a drive letter.
+static bool startsWithLocation(OutputLine *line) {
+    char *at = line->start;
+    char *end = line->start + line->length;
+    if (end - at > 2 && at[1] == ':' && (at[2] == '\\' || at[2] == '/')) at += 2;
+    
+    while (at < end && *at != ':' && *at != '(') at++;
+    if (at == line->start || at + 1 >= end) return false;
+    return at[1] >= '0' && at[1] <= '9';
+}
+
+// What gcc and clang print ahead of a diagnostic to say where it came from.
+static bool isContextLine(OutputLine *line) {
+    char *at = line->start;
+    char *end = line->start + line->length;
+    if (end - at >= 21 && memcmp(at, "In file included from", 21) == 0) return true;
+    
+    while (at < end && isWhitespace(*at)) at++;
+    if (at > line->start && end - at >= 5 && memcmp(at, "from ", 5) == 0) return true;
+    
+    return !startsWithLocation(line) && (lineContains(line->start, line->length, ": In ") ||
+                                         lineContains(line->start, line->length, ": At global scope"));
+}
+
+// cl says "file(line): warning C1234: ...", gcc and clang say
+// "file:line:col: warning: ...".
+static bool isWarning(OutputLine *line) {
+    return lineContains(line->start, line->length, ": warning");
+}
+
+static bool isError(OutputLine *line) {
+    return lineContains(line->start, line->length, ": error") || lineContains(line->start, line->length, ": fatal error");
+}
+
+// A warning or error goes together with the context lines before it, and
+// the source excerpt, notes and instantiation backtrace after it, and all
+// of it is kept or dropped as one.
+void Console::writeToolOutput(char *data, i64 length) {
+    DynamicArray<OutputLine> lines;
+    
+    char *at = data;
+    char *end = data + length;
+    while (at < end) {
+        char *lineEnd = (char *)memchr(at, '\n', end - at);
+        char *next = lineEnd ? lineEnd + 1 : end;
+        if (!lineEnd) lineEnd = end;
+
+        OutputLine line;
+        line.start = at;
+        line.length = lineEnd - at;
+        if (line.length && at[line.length - 1] == '\r') line.length--;
+        line.next = next;
+        lines.add(line);
+        
+        at = next;
+    }
+
+    int i = 0;
+    while (i < lines.count) {
+        int first = i;
+        while (i < lines.count && isContextLine(&lines[i])) i++;
+
+        if (i == lines.count || !(isWarning(&lines[i]) || isError(&lines[i]))) {
+            // Context that leads nowhere, or a line of its own.
+            if (i == first) i++;
+            write(lines[first].start, lines[i - 1].next - lines[first].start);
+            continue;
+        }
+
+        OutputLine *head = &lines[i];
+        i++;
+        while (i < lines.count && !isContextLine(&lines[i]) && !isWarning(&lines[i]) && !isError(&lines[i])) {
+            i++;
+        }
+
+        // The same warning in a header comes with different context from
+        // every file including it, so only the warning line is compared.
+        if (isWarning(head)) {
+            char *key = toCString(head->start, (i32)head->length); // Owned by seenWarnings.
+            bool added = false;
+            seenWarnings.add(key, &added);
+            
+            if (!added) {
+                free(key);
+                duplicateWarnings++;
+                continue;
+            }
+            warnings++;
+        } else {
+            errors++;
+        }
+
+        write(lines[first].start, lines[i - 1].next - lines[first].start);
+    }
+
+    // Keep one job's output from running into the next one's.
+    if (length && data[length - 1] != '\n') write("\n", 1);
+}
+
+void Console::flush(bool wait) {
+    while (hasPending()) {
+        i64 written = os::writeStdout(pending.data + pendingStart, pending.count - pendingStart, wait);
+        if (written <= 0) {
+            if (written < 0) pendingStart = pending.count; // Nowhere to write to, drop it.
+            break;
+        }
+        pendingStart += (int)written;
+    }
+
+    if (!hasPending()) {
+        pending.count = 0;
+        pendingStart = 0;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "hash_table.h"
+
+// Everything printed while jobs run goes through here. A job's output is
+// queued in one piece when it finishes, so parallel jobs never interleave,
+// and the queue is written out only as fast as the terminal takes it
+// without waiting, so a slow terminal never holds up starting the next job.
+struct Console {
+    DynamicArray<char> pending;
+    int pendingStart = 0;
+
+    // A warning in a header comes once for every translation unit that
+    // includes it; only the first one is shown.
+    StringTable<bool> seenWarnings;
+    int warnings = 0;
+    int duplicateWarnings = 0;
+    int errors = 0;
+
+    void write(char *data, i64 length);
+    void printf(char *fmt, ...);
+
+    // Queues the output of a tool, dropping repeated warnings along with
+    // their context and notes, and counting warnings and errors.
+    void writeToolOutput(char *data, i64 length);
+
+    bool hasPending() { return pendingStart < pending.count; }
+
+    // Writes as much as the terminal takes right now, or all of it with wait.
+    void flush(bool wait);
+};
+
+extern Console console;
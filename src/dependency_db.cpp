@@ -0,0 +1,249 @@
+#include "dependency_db.h"
+#include "os.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEP_FILE_MAGIC   0x44435352 // "RSCD"
+#define DEP_FILE_VERSION 2
+
+struct DepFileHeader {
+    u32 magic;
+    u32 version;
+    u32 recordCount;
+    u32 includeCount;
+    u64 stringBytes;
+};
+
+DepDatabase::~DepDatabase() {
+    if (fileData) free(fileData);
+}
+
+bool DepDatabase::load(char *path) {
+    filepath = path;
+
+    i64 length = 0;
+    u8 *data = (u8 *)os::readEntireFile(path, &length);
+    if (!data) return false;
+
+    DepFileHeader *header = (DepFileHeader *)data;
+    if (length < (i64)sizeof(DepFileHeader) ||
+        header->magic != DEP_FILE_MAGIC ||
+        header->version != DEP_FILE_VERSION) {
+        free(data);
+        return false;
+    }
+
+    i64 recordBytes = (i64)header->recordCount * sizeof(DepRecord);
+    i64 includeBytes = (i64)header->includeCount * sizeof(u32);
+    if ((i64)sizeof(DepFileHeader) + recordBytes + includeBytes + (i64)header->stringBytes != length) {
+        free(data);
+        return false;
+    }
+
+    u8 *at = data + sizeof(DepFileHeader);
+    DepRecord *fileRecords = (DepRecord *)at;
+    at += recordBytes;
+    u32 *fileIncludes = (u32 *)at;
+    at += includeBytes;
+    char *strings = (char *)at;
+    char *stringsEnd = strings + header->stringBytes;
+
+    for (u32 i = 0; i < header->includeCount; i++) {
+        if (fileIncludes[i] >= header->recordCount) {
+            free(data);
+            return false;
+        }
+    }
+
+    int count = (int)header->recordCount;
+    records.resize(count);
+    memcpy(records.data, fileRecords, recordBytes);
+    includes.resize((int)header->includeCount);
+    memcpy(includes.data, fileIncludes, includeBytes);
+    used.resize(count);
+    memset(used.data, 0, count * sizeof(bool));
+
+    // The paths are used in place, the loaded file stays alive as their storage.
+    paths.resize(count);
+    lookup.reserve(count);
+    char *s = strings;
+    for (int i = 0; i < count; i++) {
+        char *end = (char *)memchr(s, 0, stringsEnd - s);
+        if (!end) {
+            records.count = 0;
+            includes.count = 0;
+            used.count = 0;
+            paths.count = 0;
+            lookup.release();
+            free(data);
+            return false;
+        }
+
+        paths[i] = s;
+        *lookup.add(s) = i;
+        s = end + 1;
+    }
+
+    fileData = data;
+    return true;
+}
+
+bool DepDatabase::save() {
+    if (!dirty || !filepath) return true;
+
+    // Records that were rescanned left their old include ranges behind, so the
+    // include list is compacted on the way out.
+    i64 includeCount = 0;
+    i64 stringBytes = 0;
+    for (int i = 0; i < records.count; i++) {
+        includeCount += records[i].includeCount;
+        stringBytes += getStringLength(paths[i]) + 1;
+    }
+
+    i64 recordBytes = (i64)records.count * sizeof(DepRecord);
+    i64 includeBytes = includeCount * sizeof(u32);
+    i64 length = sizeof(DepFileHeader) + recordBytes + includeBytes + stringBytes;
+
+    u8 *data = (u8 *)malloc(length);
+    defer { free(data); };
+
+    DepFileHeader *header = (DepFileHeader *)data;
+    header->magic = DEP_FILE_MAGIC;
+    header->version = DEP_FILE_VERSION;
+    header->recordCount = (u32)records.count;
+    header->includeCount = (u32)includeCount;
+    header->stringBytes = (u64)stringBytes;
+
+    DepRecord *outRecords = (DepRecord *)(data + sizeof(DepFileHeader));
+    u32 *outIncludes = (u32 *)(data + sizeof(DepFileHeader) + recordBytes);
+    char *outStrings = (char *)(data + sizeof(DepFileHeader) + recordBytes + includeBytes);
+
+    u32 nextInclude = 0;
+    for (int i = 0; i < records.count; i++) {
+        DepRecord record = records[i];
+        
+        memcpy(&outIncludes[nextInclude], &includes[record.firstInclude], record.includeCount * sizeof(u32));
+        record.firstInclude = nextInclude;
+        nextInclude += record.includeCount;
+        outRecords[i] = record;
+
+        i64 pathLength = getStringLength(paths[i]) + 1;
+        memcpy(outStrings, paths[i], pathLength);
+        outStrings += pathLength;
+    }
+
+    if (!os::writeEntireFile(filepath, data, length)) return false;
+    
+    dirty = false;
+    return true;
+}
+
+void DepDatabase::prune() {
+    // What a kept record includes has to stay for its include list to
+    // point at, and so on.
+    DynamicArray<int> pending;
+    for (int i = 0; i < records.count; i++) {
+        if (used[i]) pending.add(i);
+    }
+    while (pending.count) {
+        DepRecord *record = &records[pending[--pending.count]];
+        for (u32 i = 0; i < record->includeCount; i++) {
+            u32 include = includes[record->firstInclude + i];
+            if (!used[include]) {
+                used[include] = true;
+                pending.add((int)include);
+            }
+        }
+    }
+
+    DynamicArray<int> newIndices;
+    newIndices.resize(records.count);
+    int kept = 0;
+    for (int i = 0; i < records.count; i++) {
+        newIndices[i] = used[i] ? kept++ : -1;
+    }
+    if (kept == records.count) return;
+
+    for (int i = 0; i < records.count; i++) {
+        int newIndex = newIndices[i];
+        if (newIndex < 0) continue;
+
+        DepRecord *record = &records[i];
+        for (u32 j = 0; j < record->includeCount; j++) {
+            u32 *include = &includes[record->firstInclude + j];
+            *include = (u32)newIndices[*include];
+        }
+        records[newIndex] = *record;
+        paths[newIndex] = paths[i];
+    }
+    records.count = kept;
+    paths.count = kept;
+    used.count = kept;
+
+    lookup.release();
+    for (int i = 0; i < kept; i++) {
+        *lookup.add(paths[i]) = i;
+    }
+    
+    dirty = true;
+}
+
+int DepDatabase::find(char *path) {
+    int *index = lookup.find(path);
+    if (!index) return -1;
+    
+    used[*index] = true;
+    return *index;
+}
+
+static int addPath(DepDatabase *db, char *path) {
+    int index = db->find(path);
+    if (index >= 0) return index;
+
+    index = db->records.count;
+    db->records.add();
+    db->used.add(true);
+    char *copy = copyString(path);
+    db->paths.add(copy);
+    *db->lookup.add(copy) = index;
+    return index;
+}
+
+void DepDatabase::record(char *path, u64 modtime, u64 size, DynamicArray<char *> &includePaths) {
+    int index = addPath(this, path);
+
+    u32 firstInclude = (u32)includes.count;
+    for (int i = 0; i < includePaths.count; i++) {
+        includes.add((u32)addPath(this, includePaths[i]));
+    }
+
+    DepRecord *record = &records[index];
+    record->modtime = modtime;
+    record->size = size;
+    record->firstInclude = firstInclude;
+    record->includeCount = (u32)includePaths.count;
+    record->contentHash = {};
+
+    dirty = true;
+}
+
+char *DepDatabase::getInclude(int recordIndex, int includeIndex) {
+    DepRecord *record = &records[recordIndex];
+    return paths[includes[record->firstInclude + includeIndex]];
+}
+
+Hash128 DepDatabase::getContentHash(char *path) {
+    int index = find(path);
+    if (index < 0) return {};
+    return records[index].contentHash;
+}
+
+void DepDatabase::setContentHash(char *path, Hash128 hash) {
+    int index = addPath(this, path);
+    if (hashesMatch(records[index].contentHash, hash)) return;
+    
+    records[index].contentHash = hash;
+    dirty = true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "hash_table.h"
+#include "hash.h"
+
+// What we knew about a file the last time it was scanned: if its modtime and
+// size still match, its include list and content hash can be reused without
+// reading it. Object files get a record too, holding the combined content
+// hash of the inputs they were compiled from (used by --content-hash).
+struct DepRecord {
+    u64 modtime;
+    u64 size;
+    u32 firstInclude;
+    u32 includeCount;
+    Hash128 contentHash; // Zero when unknown.
+};
+
+// Binary dependency database kept in every objdir. The file is laid out as
+//
+//     DepFileHeader
+//     DepRecord     records[recordCount]
+//     u32           includes[includeCount]   (indices into records)
+//     char          paths[stringBytes]       (NUL-terminated, in record order)
+//
+// so loading it is a single read plus a few memcpys, and saving it is a
+// single write. Neither allocates anything per record.
+struct DepDatabase {
+    char *filepath = NULL;
+    void *fileData = NULL;
+    bool dirty = false;
+
+    DynamicArray<char *> paths;
+    DynamicArray<DepRecord> records;
+    DynamicArray<u32> includes;
+    StringTable<int> lookup;
+    DynamicArray<bool> used; // Per record, whether this run asked about it.
+
+    ~DepDatabase();
+
+    bool load(char *filepath);
+    bool save();
+
+    // Drops the records nobody asked about since load, other than the ones
+    // kept records include. Only a complete, successful build asks about
+    // everything that is still needed, so that's the only time to call it.
+    void prune();
+
+    // Returns the record index for path, or -1.
+    int find(char *path);
+    void record(char *path, u64 modtime, u64 size, DynamicArray<char *> &includePaths);
+
+    char *getInclude(int recordIndex, int includeIndex);
+
+    Hash128 getContentHash(char *path);
+    void setContentHash(char *path, Hash128 hash);
+};
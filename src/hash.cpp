@@ -0,0 +1,171 @@
+#include "hash.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HASH_SSE2 1
+#endif
+
+#define PRIME32_1 0x9E3779B1u
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+
+#define STRIPE_LENGTH 64
+#define SECRET_SIZE 192
+#define STRIPES_PER_BLOCK ((SECRET_SIZE - STRIPE_LENGTH) / 8)
+
+// The secret only has to look random and never change, so it is generated
+// once with splitmix64 instead of being pasted in.
+static u8 secret[SECRET_SIZE];
+static bool secretInitialized = false;
+
+static void initSecret() {
+    u64 state = 0x2545F4914F6CDD1Dull;
+    for (int i = 0; i < SECRET_SIZE; i += 8) {
+        state += 0x9E3779B97F4A7C15ull;
+        u64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z = z ^ (z >> 31);
+        memcpy(secret + i, &z, 8);
+    }
+    secretInitialized = true;
+}
+
+static inline u64 read64(u8 *p) {
+    u64 result;
+    memcpy(&result, p, 8);
+    return result;
+}
+
+static inline u64 multiplyFold64(u64 a, u64 b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)a * b;
+    return (u64)product ^ (u64)(product >> 64);
+#elif defined(COMPILER_MSVC)
+    u64 high;
+    u64 low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    u64 aLow = (u32)a, aHigh = a >> 32;
+    u64 bLow = (u32)b, bHigh = b >> 32;
+    u64 lowLow = aLow * bLow;
+    u64 highLow = aHigh * bLow;
+    u64 lowHigh = aLow * bHigh;
+    u64 highHigh = aHigh * bHigh;
+    u64 cross = (lowLow >> 32) + (u32)highLow + lowHigh;
+    u64 upper = (highLow >> 32) + (cross >> 32) + highHigh;
+    u64 lower = (cross << 32) | (u32)lowLow;
+    return lower ^ upper;
+#endif
+}
+
+static inline u64 avalanche(u64 h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline void accumulateStripe(u64 *acc, u8 *input, u8 *key) {
+#ifdef HASH_SSE2
+    __m128i *accVec = (__m128i *)acc;
+    for (int i = 0; i < STRIPE_LENGTH / 16; i++) {
+        __m128i dataVec = _mm_loadu_si128((__m128i *)(input + 16 * i));
+        __m128i keyVec = _mm_loadu_si128((__m128i *)(key + 16 * i));
+        __m128i dataKey = _mm_xor_si128(dataVec, keyVec);
+        __m128i dataKeyHigh = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product = _mm_mul_epu32(dataKey, dataKeyHigh);
+        __m128i dataSwapped = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i sum = _mm_add_epi64(_mm_loadu_si128(&accVec[i]), dataSwapped);
+        _mm_storeu_si128(&accVec[i], _mm_add_epi64(product, sum));
+    }
+#else
+    for (int i = 0; i < 8; i++) {
+        u64 dataValue = read64(input + 8 * i);
+        u64 dataKey = dataValue ^ read64(key + 8 * i);
+        acc[i ^ 1] += dataValue;
+        acc[i] += (u64)(u32)dataKey * (dataKey >> 32);
+    }
+#endif
+}
+
+static inline void scramble(u64 *acc, u8 *key) {
+    for (int i = 0; i < 8; i++) {
+        u64 a = acc[i];
+        a ^= a >> 47;
+        a ^= read64(key + 8 * i);
+        a *= PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+static u64 mergeAccumulators(u64 *acc, u8 *key, u64 start) {
+    u64 result = start;
+    for (int i = 0; i < 4; i++) {
+        result += multiplyFold64(acc[2 * i] ^ read64(key + 16 * i), acc[2 * i + 1] ^ read64(key + 16 * i + 8));
+    }
+    return avalanche(result);
+}
+
+Hash128 hashContents(void *data, i64 length, u64 seed) {
+    if (!secretInitialized) initSecret();
+
+    u64 acc[8] = {
+        PRIME32_1, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_1 ^ seed, PRIME64_2 + seed, PRIME64_3 - seed, PRIME32_1 + seed,
+    };
+
+    u8 *input = (u8 *)data;
+    i64 stripeCount = length / STRIPE_LENGTH;
+    
+    i64 stripe = 0;
+    while (stripe < stripeCount) {
+        i64 stripesInBlock = stripeCount - stripe;
+        if (stripesInBlock > STRIPES_PER_BLOCK) stripesInBlock = STRIPES_PER_BLOCK;
+
+        for (i64 i = 0; i < stripesInBlock; i++) {
+            accumulateStripe(acc, input + (stripe + i) * STRIPE_LENGTH, secret + i * 8);
+        }
+        stripe += stripesInBlock;
+
+        if (stripesInBlock == STRIPES_PER_BLOCK) {
+            scramble(acc, secret + SECRET_SIZE - STRIPE_LENGTH);
+        }
+    }
+
+    // The tail goes through one zero-padded stripe; the length is mixed in
+    // below so padding can't collide with real zeros.
+    i64 tailLength = length - stripeCount * STRIPE_LENGTH;
+    if (tailLength > 0) {
+        u8 tail[STRIPE_LENGTH] = {};
+        memcpy(tail, input + stripeCount * STRIPE_LENGTH, tailLength);
+        accumulateStripe(acc, tail, secret + SECRET_SIZE - STRIPE_LENGTH - 7);
+    }
+
+    Hash128 result;
+    result.low = mergeAccumulators(acc, secret + 11, (u64)length * PRIME64_1);
+    result.high = mergeAccumulators(acc, secret + SECRET_SIZE - STRIPE_LENGTH - 11, ~((u64)length * PRIME64_2));
+    return result;
+}
+
+void HashBuilder::add(void *data, i64 length) {
+    Hash128 hash = hashContents(data, length, state.low);
+    add(hash);
+}
+
+void HashBuilder::add(char *s) {
+    add(s, (i64)strlen(s) + 1);
+}
+
+void HashBuilder::add(Hash128 hash) {
+    state.low = avalanche((state.low ^ hash.low) * PRIME64_1 + hash.high);
+    state.high = avalanche((state.high ^ hash.high) * PRIME64_2 + hash.low);
+}
+
+void HashBuilder::add(u64 value) {
+    Hash128 hash = { value, ~value };
+    add(hash);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "defines.h"
+
+// FNV-1a, used for hash table keys. Not meant for file contents.
+inline u64 hashBytes(void *data, i64 length, u64 seed = 0xcbf29ce484222325ull) {
+    u8 *at = (u8 *)data;
+    u64 hash = seed;
+    for (i64 i = 0; i < length; i++) {
+        hash ^= at[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline u64 hashString(char *s, u64 seed = 0xcbf29ce484222325ull) {
+    u64 hash = seed;
+    for (u8 *at = (u8 *)s; *at; at++) {
+        hash ^= *at;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+struct Hash128 {
+    u64 low;
+    u64 high;
+};
+
+inline bool hashesMatch(Hash128 a, Hash128 b) {
+    return a.low == b.low && a.high == b.high;
+}
+
+inline bool isZero(Hash128 hash) {
+    return hash.low == 0 && hash.high == 0;
+}
+
+// Fast 128-bit hash for file contents, built like XXH3: eight 64-bit lanes
+// are fed 64 bytes at a time (two SSE2 multiplies per 16 bytes where
+// available), and folded into two independent 64-bit halves at the end. It
+// is not cryptographic, only meant to tell whether a file changed.
+Hash128 hashContents(void *data, i64 length, u64 seed = 0);
+
+// Streams several inputs into one hash, e.g. every file a translation unit
+// depends on.
+struct HashBuilder {
+    Hash128 state = { 0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full };
+
+    void add(void *data, i64 length);
+    void add(char *s);
+    void add(Hash128 hash);
+    void add(u64 value);
+};
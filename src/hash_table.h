@@ -0,0 +1,101 @@
+#pragma once
+
+#include "defines.h"
+#include "hash.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Open addressing hash table from NUL-terminated strings to T. Keys are not
+// copied, the caller keeps them alive for as long as the table is used. Like
+// DynamicArray, values are moved around with memcpy.
+template <typename T>
+struct StringTable {
+    int capacity;
+    int count;
+    u64 *hashes;
+    char **keys;
+    T *values;
+
+    inline StringTable() : capacity(0), count(0), hashes(NULL), keys(NULL), values(NULL) {}
+    inline ~StringTable() { release(); }
+
+    inline void release() {
+        if (hashes) free(hashes);
+        if (keys) free(keys);
+        if (values) free(values);
+        hashes = NULL;
+        keys = NULL;
+        values = NULL;
+        capacity = 0;
+        count = 0;
+    }
+
+    // Makes room for wantedCount entries without rehashing.
+    inline void reserve(int wantedCount) {
+        int wantedCapacity = 32;
+        while (wantedCapacity < wantedCount * 2) wantedCapacity *= 2;
+        if (capacity >= wantedCapacity) return;
+
+        int oldCapacity = capacity;
+        u64 *oldHashes = hashes;
+        char **oldKeys = keys;
+        T *oldValues = values;
+
+        capacity = wantedCapacity;
+        count = 0;
+        hashes = (u64 *)calloc(capacity, sizeof(u64));
+        keys = (char **)calloc(capacity, sizeof(char *));
+        values = (T *)calloc(capacity, sizeof(T));
+
+        for (int i = 0; i < oldCapacity; i++) {
+            if (!oldKeys[i]) continue;
+
+            int slot = findSlot(oldKeys[i], oldHashes[i]);
+            hashes[slot] = oldHashes[i];
+            keys[slot] = oldKeys[i];
+            memcpy(&values[slot], &oldValues[i], sizeof(T));
+            count++;
+        }
+
+        if (oldHashes) free(oldHashes);
+        if (oldKeys) free(oldKeys);
+        if (oldValues) free(oldValues);
+    }
+
+    inline int findSlot(char *key, u64 hash) {
+        int mask = capacity - 1;
+        int slot = (int)(hash & mask);
+        while (keys[slot]) {
+            if (hashes[slot] == hash && stringsMatch(keys[slot], key)) break;
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    inline T *find(char *key) {
+        if (!count) return NULL;
+
+        int slot = findSlot(key, hashString(key));
+        if (!keys[slot]) return NULL;
+        return &values[slot];
+    }
+
+    // Returns the value for key, inserting a zero-initialized one if needed.
+    inline T *add(char *key, bool *added = NULL) {
+        reserve(count + 1);
+
+        u64 hash = hashString(key);
+        int slot = findSlot(key, hash);
+        if (added) *added = keys[slot] == NULL;
+        if (!keys[slot]) {
+            hashes[slot] = hash;
+            keys[slot] = key;
+            T tmp = {};
+            memcpy(&values[slot], &tmp, sizeof(T));
+            count++;
+        }
+        return &values[slot];
+    }
+};
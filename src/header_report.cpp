@@ -0,0 +1,115 @@
+#include "header_report.h"
+#include "utils.h"
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Headers in external include directories are never stat'ed for the build,
+// so they are looked up here. What they include is never scanned either.
+static u64 getNodeSize(IncludeNode *node) {
+    if (!node->immutable) return node->size;
+
+    os::FileInfo info;
+    if (!os::getCachedFileInfo(node->path, &info)) return 0;
+    return info.size;
+}
+
+void HeaderReport::addTranslationUnit(IncludeGraph *graph, IncludeNode *unit) {
+    if (!unit->exists) return;
+    unitCount++;
+
+    DynamicArray<IncludeNode *> inputs;
+    graph->collectIncludes(unit, inputs);
+
+    bytesParsed += unit->size;
+    for (int i = 1; i < inputs.count; i++) {
+        IncludeNode *node = inputs[i];
+        if (!node->exists) continue;
+
+        HeaderStats **existing = headers.find(node->path);
+        HeaderStats *stats;
+        if (existing) {
+            stats = *existing;
+        } else {
+            stats = new HeaderStats();
+            stats->path = copyString(node->path);
+            stats->immutable = node->immutable;
+            stats->size = getNodeSize(node);
+            *headers.add(stats->path) = stats;
+            headerList.add(stats);
+
+            // inputs is complete, so collecting again is fine. With several
+            // include directory lists a header can pull in different files
+            // per graph; the first one it is seen in counts.
+            DynamicArray<IncludeNode *> includes;
+            graph->collectIncludes(node, includes);
+            for (int j = 0; j < includes.count; j++) {
+                if (includes[j]->exists) stats->transitiveSize += getNodeSize(includes[j]);
+            }
+        }
+
+        stats->units++;
+        bytesParsed += stats->size;
+        bytesParsedInHeaders += stats->size;
+    }
+}
+
+static u64 getCost(HeaderStats *stats) {
+    return (u64)stats->units * stats->transitiveSize;
+}
+
+static int compareCosts(const void *a, const void *b) {
+    HeaderStats *statsA = *(HeaderStats **)a;
+    HeaderStats *statsB = *(HeaderStats **)b;
+    u64 costA = getCost(statsA);
+    u64 costB = getCost(statsB);
+    if (costA != costB) return costA > costB ? -1 : 1;
+    return strcmp(statsA->path, statsB->path);
+}
+
+static char *formatBytes(u64 bytes) {
+    if (bytes >= 1024ull * 1024 * 1024) return mprintf("%.1f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+    if (bytes >= 1024ull * 1024) return mprintf("%.1f MB", bytes / (1024.0 * 1024.0));
+    if (bytes >= 1024ull) return mprintf("%.1f KB", bytes / 1024.0);
+    return mprintf("%llu B", (unsigned long long)bytes);
+}
+
+void HeaderReport::print(int count) {
+    DynamicArray<HeaderStats *> sorted;
+    for (int i = 0; i < headerList.count; i++) {
+        sorted.add(headerList[i]);
+    }
+    qsort(sorted.data, sorted.count, sizeof(HeaderStats *), compareCosts);
+
+    char *total = formatBytes(bytesParsed);
+    char *inHeaders = formatBytes(bytesParsedInHeaders);
+    printf("%d translation unit%s parse %s, %s of it in %d header%s.\n", unitCount, unitCount == 1 ? "" : "s",
+           total, inHeaders, sorted.count, sorted.count == 1 ? "" : "s");
+    free(total);
+    free(inHeaders);
+
+    if (!sorted.count) return;
+
+    int shown = sorted.count < count ? sorted.count : count;
+    printf("Costliest headers (units including it x bytes it pulls in):\n");
+    printf("    %10s  %6s  %10s  %10s  %s\n", "Cost", "Units", "Size", "With incl.", "Header");
+
+    bool anyImmutable = false;
+    for (int i = 0; i < shown; i++) {
+        HeaderStats *stats = sorted[i];
+        char *cost = formatBytes(getCost(stats));
+        char *size = formatBytes(stats->size);
+        char *transitiveSize = formatBytes(stats->transitiveSize);
+        printf("    %10s  %6d  %10s  %10s  %s%s\n", cost, stats->units, size, transitiveSize, stats->path, stats->immutable ? " *" : "");
+        free(cost);
+        free(size);
+        free(transitiveSize);
+        
+        if (stats->immutable) anyImmutable = true;
+    }
+    if (anyImmutable) {
+        printf("* External header, what it includes is not followed.\n");
+    }
+}
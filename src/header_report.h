@@ -0,0 +1,27 @@
+#pragma once
+
+#include "include_graph.h"
+
+struct HeaderStats {
+    char *path;
+    bool immutable;
+    int units;          // Translation units that include it, directly or not.
+    u64 size;
+    u64 transitiveSize; // Its own size plus that of everything it includes.
+};
+
+// What --header-report prints instead of building: every header the
+// projects' translation units reach through the include graph, ranked by
+// how many bytes the compiler ends up parsing on its account, which is the
+// number of units including it times the bytes it pulls in. The top of that
+// list is what belongs in a precompiled header, or needs its includes cut.
+struct HeaderReport {
+    StringTable<HeaderStats *> headers;
+    DynamicArray<HeaderStats *> headerList;
+    int unitCount = 0;
+    u64 bytesParsed = 0;
+    u64 bytesParsedInHeaders = 0;
+
+    void addTranslationUnit(IncludeGraph *graph, IncludeNode *unit);
+    void print(int count);
+};
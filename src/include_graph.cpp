@@ -0,0 +1,478 @@
+#include "include_graph.h"
+#include "dependency_db.h"
+#include "utils.h"
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct IncludeDirective {
+    char *name;
+    bool angled;
+};
+
+struct ScannedFile {
+    bool changed; // Scanned again the next time it's asked for.
+    bool exists;
+    Hash128 contentHash;
+    DynamicArray<IncludeDirective> directives;
+};
+
+// Raw #include lines of every file read this run, shared by all graphs.
+static StringTable<ScannedFile *> scannedFiles;
+
+static StringTable<IncludeGraph *> includeGraphs;
+
+static IncludeGraphCounters counters;
+
+static char *getDirectoryFromFilename(char *string) {
+    if (!string) return NULL;
+
+    char *result = copyString(string);
+    
+    char *slash = strrchr(result, '/');
+    if (!slash) {
+        delete[] result;
+        return NULL;
+    }
+    result[slash - result] = 0;
+    return result;
+}
+
+// Goes through the os stat cache, so checking an include candidate lists its
+// directory once and is a hash probe after that.
+static bool cachedFileExists(char *path) {
+    os::FileInfo info;
+    return os::getCachedFileInfo(path, &info) && !info.isDirectory;
+}
+
+static ScannedFile *scanFileForIncludes(char *filename) {
+    ScannedFile **existing = scannedFiles.find(filename);
+    ScannedFile *scanned;
+    if (existing) {
+        scanned = *existing;
+        if (!scanned->changed) return scanned;
+
+        for (int i = 0; i < scanned->directives.count; i++) {
+            delete[] scanned->directives[i].name;
+        }
+        scanned->directives.count = 0;
+        scanned->changed = false;
+        scanned->exists = false;
+        scanned->contentHash = {};
+    } else {
+        scanned = new ScannedFile();
+        *scannedFiles.add(copyString(filename)) = scanned;
+    }
+    
+    // Headers are mapped rather than read, and the mapping is only ever read
+    // from, so scanning a big header tree copies nothing.
+    os::MappedFile file;
+    if (!os::mapFile(filename, &file)) return scanned;
+    defer { os::unmapFile(&file); };
+
+    // Hashing is far cheaper than getting the data in the first place, so it
+    // is done while we have it anyway.
+    scanned->exists = true;
+    scanned->contentHash = hashContents(file.data, file.length);
+    counters.filesScanned++;
+    counters.bytesScanned += file.length;
+
+    char *includeKeyword = "include";
+    i64 includeKeywordLength = getStringLength(includeKeyword);
+
+    char *at = (char *)file.data;
+    char *end = at + file.length;
+    while (at < end) {
+        char *lineEnd = (char *)memchr(at, '\n', end - at);
+        if (!lineEnd) lineEnd = end;
+        char *line = at;
+        at = lineEnd < end ? lineEnd + 1 : end;
+
+        while (line < lineEnd && isWhitespace(line[0])) line++;
+        if (line == lineEnd || line[0] != '#') continue;
+        line++;
+        
+        // "# include" is as valid as "#include".
+        while (line < lineEnd && isWhitespace(line[0])) line++;
+        if (lineEnd - line < includeKeywordLength || memcmp(line, includeKeyword, includeKeywordLength) != 0) continue;
+        line += includeKeywordLength;
+        while (line < lineEnd && isWhitespace(line[0])) line++;
+
+        if (line == lineEnd || (line[0] != '"' && line[0] != '<')) {
+            //fprintf(stderr, "Shit happened\n");
+            continue;
+        }
+
+        bool angled = line[0] == '<';
+        line++;
+
+        char *nameEnd = line;
+        while (nameEnd < lineEnd && nameEnd[0] != '>' && nameEnd[0] != '"') nameEnd++;
+        if (nameEnd == lineEnd) {
+            fprintf(stderr, "EOF found while parsing string in c file.\n");
+            continue;
+        }
+
+        i64 nameLength = nameEnd - line;
+        IncludeDirective directive;
+        directive.name = new char[nameLength + 1];
+        memcpy(directive.name, line, nameLength);
+        directive.name[nameLength] = 0;
+        directive.angled = angled;
+        scanned->directives.add(directive);
+    }
+
+    return scanned;
+}
+
+IncludeGraph *getIncludeGraph(DynamicArray<char *> &includeDirs, DynamicArray<char *> &externalIncludeDirs) {
+    StringBuilder keyBuilder;
+    for (int i = 0; i < includeDirs.count; i++) {
+        keyBuilder.printf("%s;", includeDirs[i]);
+    }
+    keyBuilder.add('|');
+    for (int i = 0; i < externalIncludeDirs.count; i++) {
+        keyBuilder.printf("%s;", externalIncludeDirs[i]);
+    }
+    char *key = keyBuilder.toString();
+
+    IncludeGraph **existing = includeGraphs.find(key);
+    if (existing) {
+        free(key);
+        return *existing;
+    }
+
+    IncludeGraph *graph = new IncludeGraph();
+    *includeGraphs.add(key) = graph;
+
+    for (int i = 0; i < includeDirs.count; i++) {
+        IncludeSearchDir dir = { copyNormalizedPath(includeDirs[i]), false };
+        graph->searchDirs.add(dir);
+    }
+    for (int i = 0; i < externalIncludeDirs.count; i++) {
+        IncludeSearchDir dir = { copyNormalizedPath(externalIncludeDirs[i]), true };
+        graph->searchDirs.add(dir);
+    }
+
+    return graph;
+}
+
+// Quoted includes are looked up next to the including file first, then, like
+// angled ones, in the include directories in order.
+char *IncludeGraph::resolveInclude(char *includerDirectory, char *name, bool angled) {
+    if (!angled) {
+        char *candidate = includerDirectory ? mprintf("%s/%s", includerDirectory, name) : copyString(name);
+        char *path = copyNormalizedPath(candidate);
+        free(candidate);
+        
+        if (cachedFileExists(path)) return path;
+        delete[] path;
+    }
+
+    for (int i = 0; i < searchDirs.count; i++) {
+        IncludeSearchDir *dir = &searchDirs[i];
+        char *candidate = mprintf("%s/%s", dir->path, name);
+        char *path = copyNormalizedPath(candidate);
+        free(candidate);
+
+        // External headers never need their metadata, so the listing is enough.
+        bool exists = dir->immutable ? os::getCachedFileExists(path) : cachedFileExists(path);
+        if (exists) return path;
+        delete[] path;
+    }
+
+    return NULL;
+}
+
+bool IncludeGraph::isImmutablePath(char *path) {
+    for (int i = 0; i < searchDirs.count; i++) {
+        IncludeSearchDir *dir = &searchDirs[i];
+        if (!dir->immutable) continue;
+
+        i64 length = getStringLength(dir->path);
+        if (startsWith(path, dir->path) && (path[length] == '/' || path[length] == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool recordMatches(DepDatabase *db, int index, IncludeNode *node) {
+    if (index < 0) return false;
+    
+    DepRecord *record = &db->records[index];
+    return record->modtime == node->modtime && record->size == node->size;
+}
+
+IncludeNode *IncludeGraph::getNode(char *path, DepDatabase *db) {
+    IncludeNode **existing = nodes.find(path);
+    if (existing) {
+        IncludeNode *node = *existing;
+        if (db && node->recordedIn != db) recordNode(node, db);
+        counters.hits++;
+        return node;
+    }
+    counters.misses++;
+
+    IncludeNode *node = new IncludeNode();
+    node->path = copyString(path);
+    *nodes.add(node->path) = node;
+
+    // Immutable headers only ever get here after resolveInclude found them,
+    // so they exist, and they are never looked at again.
+    if (isImmutablePath(path)) {
+        node->exists = true;
+        node->immutable = true;
+        return node;
+    }
+
+    loadNode(node, db);
+    return node;
+}
+
+void IncludeGraph::loadNode(IncludeNode *node, DepDatabase *db) {
+    char *path = node->path;
+    
+    os::FileInfo info;
+    node->exists = os::getCachedFileInfo(path, &info) && !info.isDirectory;
+    if (!node->exists) return;
+    node->modtime = info.modtime;
+    node->size = info.size;
+
+    node->recordedIn = db;
+    
+    // The resolved include list comes from the database when the file is
+    // unchanged, otherwise the file is scanned and the database updated.
+    DynamicArray<char *> includePaths;
+    bool ownsIncludePaths = false;
+    
+    int index = db ? db->find(path) : -1;
+    if (recordMatches(db, index, node)) {
+        counters.databaseHits++;
+        int includeCount = (int)db->records[index].includeCount;
+        for (int i = 0; i < includeCount; i++) {
+            includePaths.add(db->getInclude(index, i));
+        }
+    } else {
+        ScannedFile *scanned = scanFileForIncludes(path);
+        
+        char *directory = getDirectoryFromFilename(path);
+        defer { if (directory) delete[] directory; };
+        
+        for (int i = 0; i < scanned->directives.count; i++) {
+            IncludeDirective *directive = &scanned->directives[i];
+            char *resolved = resolveInclude(directory, directive->name, directive->angled);
+            if (resolved) includePaths.add(resolved);
+        }
+        
+        ownsIncludePaths = true;
+        if (db) db->record(path, node->modtime, node->size, includePaths);
+    }
+
+    for (int i = 0; i < includePaths.count; i++) {
+        node->includes.add(getNode(includePaths[i], db));
+        if (ownsIncludePaths) delete[] includePaths[i];
+    }
+}
+
+// A node scanned for one project's database still has to end up in the
+// databases of the other projects that reach it, without being read again.
+void IncludeGraph::recordNode(IncludeNode *node, DepDatabase *db) {
+    node->recordedIn = db;
+    if (!node->exists || node->immutable) return;
+
+    if (!recordMatches(db, db->find(node->path), node)) {
+        DynamicArray<char *> includePaths;
+        for (int i = 0; i < node->includes.count; i++) {
+            IncludeNode *include = node->includes[i];
+            if (include->exists) includePaths.add(include->path);
+        }
+        db->record(node->path, node->modtime, node->size, includePaths);
+    }
+
+    for (int i = 0; i < node->includes.count; i++) {
+        IncludeNode *include = node->includes[i];
+        if (include->recordedIn != db) recordNode(include, db);
+    }
+}
+
+u64 IncludeGraph::getNewestModtime(IncludeNode *node) {
+    if (!node->newestModtimeComputed) {
+        computeNewestModtime(node);
+    }
+    return node->newestModtime;
+}
+
+// Tarjan's strongly connected components: every file in an include cycle
+// sees the same set of files, so they all get the same newest modtime, and
+// each node is finished exactly once.
+void IncludeGraph::computeNewestModtime(IncludeNode *node) {
+    node->visitIndex = nextVisitIndex;
+    node->lowLink = nextVisitIndex;
+    nextVisitIndex++;
+    
+    stack.add(node);
+    node->onStack = true;
+    node->newestModtime = node->modtime;
+
+    for (int i = 0; i < node->includes.count; i++) {
+        IncludeNode *include = node->includes[i];
+
+        if (include->newestModtimeComputed) {
+            // Nothing to do but take its result.
+        } else if (include->visitIndex < 0) {
+            computeNewestModtime(include);
+            if (include->lowLink < node->lowLink) node->lowLink = include->lowLink;
+        } else if (include->onStack) {
+            if (include->visitIndex < node->lowLink) node->lowLink = include->visitIndex;
+        }
+
+        if (include->newestModtime > node->newestModtime) {
+            node->newestModtime = include->newestModtime;
+        }
+    }
+
+    if (node->lowLink != node->visitIndex) return;
+
+    // node is the root of a component: everything above it on the stack is in it.
+    int first = stack.count - 1;
+    while (stack[first] != node) first--;
+
+    u64 newest = 0;
+    for (int i = first; i < stack.count; i++) {
+        if (stack[i]->newestModtime > newest) newest = stack[i]->newestModtime;
+    }
+    for (int i = first; i < stack.count; i++) {
+        IncludeNode *member = stack[i];
+        member->newestModtime = newest;
+        member->newestModtimeComputed = true;
+        member->onStack = false;
+    }
+    stack.count = first;
+}
+
+Hash128 IncludeGraph::getContentHash(IncludeNode *node, DepDatabase *db) {
+    if (node->hasContentHash) return node->contentHash;
+
+    // Only read the file if the database has no hash for this exact version.
+    int index = db ? db->find(node->path) : -1;
+    if (recordMatches(db, index, node) && !isZero(db->records[index].contentHash)) {
+        node->contentHash = db->records[index].contentHash;
+    } else {
+        ScannedFile *scanned = scanFileForIncludes(node->path);
+        node->contentHash = scanned->contentHash;
+        if (db && recordMatches(db, index, node)) {
+            db->setContentHash(node->path, node->contentHash);
+        }
+    }
+    
+    node->hasContentHash = true;
+    return node->contentHash;
+}
+
+static void collectNodes(IncludeNode *node, u32 generation, DynamicArray<IncludeNode *> &result) {
+    if (node->collectGeneration == generation) return;
+    node->collectGeneration = generation;
+    result.add(node);
+
+    for (int i = 0; i < node->includes.count; i++) {
+        collectNodes(node->includes[i], generation, result);
+    }
+}
+
+void IncludeGraph::collectIncludes(IncludeNode *node, DynamicArray<IncludeNode *> &result) {
+    collectNodes(node, ++collectGeneration, result);
+}
+
+bool IncludeGraph::getInputSignature(DynamicArray<char *> &paths, DepDatabase *db, Hash128 *signature) {
+    HashBuilder builder;
+    for (int i = 0; i < paths.count; i++) {
+        IncludeNode *input = getNode(paths[i], db);
+        if (!input->exists) return false;
+        
+        // Immutable headers contribute their name only, they never change.
+        builder.add(input->path);
+        if (!input->immutable) {
+            builder.add(getContentHash(input, db));
+        }
+    }
+    
+    *signature = builder.state;
+    return true;
+}
+
+IncludeGraphCounters getIncludeGraphCounters() {
+    return counters;
+}
+
+void getIncludeGraphFiles(DynamicArray<char *> &paths) {
+    for (int i = 0; i < includeGraphs.capacity; i++) {
+        if (!includeGraphs.keys[i]) continue;
+        IncludeGraph *graph = includeGraphs.values[i];
+
+        for (int j = 0; j < graph->nodes.capacity; j++) {
+            if (!graph->nodes.keys[j]) continue;
+            IncludeNode *node = graph->nodes.values[j];
+            if (node->exists && !node->immutable) paths.add(node->path);
+        }
+    }
+}
+
+// The changed files are read again right away, since their includers point
+// at them directly and would see the old modtimes otherwise. The database
+// they go into is only known in the next build, which records them there as
+// it reaches them.
+void IncludeGraph::invalidate(DynamicArray<char *> &changedPaths) {
+    bool structureChanged = false;
+    for (int i = 0; i < changedPaths.count; i++) {
+        IncludeNode **existing = nodes.find(changedPaths[i]);
+        if (!existing) continue;
+
+        IncludeNode *node = *existing;
+        if (node->immutable) continue;
+
+        bool existed = node->exists;
+        node->exists = false;
+        node->modtime = 0;
+        node->size = 0;
+        node->hasContentHash = false;
+        node->includes.count = 0;
+        loadNode(node, NULL);
+
+        if (node->exists != existed) structureChanged = true;
+    }
+
+    if (structureChanged) {
+        for (int i = 0; i < nodes.capacity; i++) {
+            if (!nodes.keys[i]) continue;
+            delete[] nodes.values[i]->path;
+            delete nodes.values[i];
+        }
+        nodes.release();
+        return;
+    }
+
+    for (int i = 0; i < nodes.capacity; i++) {
+        if (!nodes.keys[i]) continue;
+        IncludeNode *node = nodes.values[i];
+        node->newestModtimeComputed = false;
+        node->newestModtime = 0;
+        node->visitIndex = -1;
+        node->lowLink = 0;
+        node->onStack = false;
+        node->recordedIn = NULL;
+    }
+}
+
+void invalidateIncludeGraphs(DynamicArray<char *> &changedPaths) {
+    for (int i = 0; i < changedPaths.count; i++) {
+        ScannedFile **scanned = scannedFiles.find(changedPaths[i]);
+        if (scanned) (*scanned)->changed = true;
+    }
+
+    for (int i = 0; i < includeGraphs.capacity; i++) {
+        if (includeGraphs.keys[i]) includeGraphs.values[i]->invalidate(changedPaths);
+    }
+}
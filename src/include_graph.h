@@ -0,0 +1,108 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "hash_table.h"
+#include "hash.h"
+
+struct DepDatabase;
+
+struct IncludeNode {
+    char *path = NULL;
+    bool exists = false;
+    bool immutable = false;
+    u64 modtime = 0;
+    u64 size = 0;
+
+    DynamicArray<IncludeNode *> includes;
+
+    // Newest modtime of this file and everything it includes, directly or not.
+    bool newestModtimeComputed = false;
+    u64 newestModtime = 0;
+
+    bool hasContentHash = false;
+    Hash128 contentHash = {};
+
+    // Bookkeeping for getNewestModtime, collectIncludes and for keeping every project's
+    // dependency database in sync with the shared graph.
+    int visitIndex = -1;
+    int lowLink = 0;
+    bool onStack = false;
+    u32 collectGeneration = 0;
+    DepDatabase *recordedIn = NULL;
+};
+
+struct IncludeSearchDir {
+    char *path;
+    bool immutable;
+};
+
+// Every source and header reached during a run, each stat'ed once no matter
+// how many translation units, projects or configurations include it. Since
+// includes resolve differently with different include directories there is
+// one graph per distinct include directory list, but a file's text is only
+// ever scanned once per run across all graphs.
+//
+// Headers found in immutable (external/system) directories are never
+// stat'ed or scanned and count as infinitely old.
+//
+// Include cycles are fine: getNewestModtime treats each cycle as a single node.
+struct IncludeGraph {
+    DynamicArray<IncludeSearchDir> searchDirs;
+    StringTable<IncludeNode *> nodes;
+
+    IncludeNode *getNode(char *path, DepDatabase *db);
+    u64 getNewestModtime(IncludeNode *node);
+
+    // node followed by everything it includes, directly or not, each once.
+    void collectIncludes(IncludeNode *node, DynamicArray<IncludeNode *> &result);
+
+    Hash128 getContentHash(IncludeNode *node, DepDatabase *db);
+    
+    // Combined content hash of a dependency list the compiler reported, with
+    // the files' contents as they are now: two compiles with the same
+    // signature read exactly the same text. False when a file is gone.
+    bool getInputSignature(DynamicArray<char *> &paths, DepDatabase *db, Hash128 *signature);
+
+    // See invalidateIncludeGraphs.
+    void invalidate(DynamicArray<char *> &changedPaths);
+
+    // Whether path is inside one of the immutable search directories.
+    bool isImmutablePath(char *path);
+
+private:
+    int nextVisitIndex = 0;
+    u32 collectGeneration = 0;
+    DynamicArray<IncludeNode *> stack;
+
+    char *resolveInclude(char *includerDirectory, char *name, bool angled);
+    void loadNode(IncludeNode *node, DepDatabase *db);
+    void recordNode(IncludeNode *node, DepDatabase *db);
+    void computeNewestModtime(IncludeNode *node);
+};
+
+// includeDirs are searched in order, then externalIncludeDirs. Both are
+// expected to be macro-substituted already.
+IncludeGraph *getIncludeGraph(DynamicArray<char *> &includeDirs, DynamicArray<char *> &externalIncludeDirs);
+
+// Totals over all graphs, for --stats.
+struct IncludeGraphCounters {
+    u64 hits;         // getNode found the file in the graph already.
+    u64 misses;
+    u64 databaseHits; // Include lists taken from a dependency database instead of scanning.
+    u64 filesScanned;
+    u64 bytesScanned;
+};
+
+IncludeGraphCounters getIncludeGraphCounters();
+
+// For --watch: the files any graph depends on, immutable ones aside. The
+// paths belong to the graphs.
+void getIncludeGraphFiles(DynamicArray<char *> &paths);
+
+// For --watch: the files at changedPaths (normalized, with the stat cache
+// already invalidated for them) are read again the next time they are asked
+// for, and every graph forgets what it worked out for the last build, while
+// everything else stays as it is. When a file appeared or went away, what
+// the includes resolve to may change too, so the graphs start over, though
+// still without scanning unchanged files again.
+void invalidateIncludeGraphs(DynamicArray<char *> &changedPaths);
@@ -0,0 +1,378 @@
+#include "jobs.h"
+#include "utils.h"
+#include "console.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static os::Jobserver jobserver = {};
+static bool haveJobserver = false;
+
+// Picks the --jobserver-auth= value (--jobserver-fds= before make 4.2) and
+// the -j count out of MAKEFLAGS. Later words win, as they do for make.
+static void parseMakeflags(char *makeflags, char **auth, int *jobCount) {
+    char *cursor = makeflags;
+    while (*cursor) {
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        char *word = cursor;
+        while (*cursor && *cursor != ' ' && *cursor != '\t') cursor++;
+
+        char *value = NULL;
+        if (startsWith(word, "--jobserver-auth=")) value = word + getStringLength("--jobserver-auth=");
+        if (startsWith(word, "--jobserver-fds=")) value = word + getStringLength("--jobserver-fds=");
+        if (value) {
+            if (*auth) free(*auth);
+            *auth = mprintf("%.*s", (int)(cursor - value), value);
+        } else if (startsWith(word, "-j")) {
+            *jobCount = atoi(word + 2);
+        }
+    }
+}
+
+int setUpJobserver(int jobCount) {
+    char *makeflags = getenv("MAKEFLAGS");
+
+    if (!jobCount && makeflags) {
+        char *auth = NULL;
+        int makeJobCount = 0;
+        parseMakeflags(makeflags, &auth, &makeJobCount);
+
+        if (auth) {
+            defer { free(auth); };
+            if (os::connectJobserver(auth, &jobserver)) {
+                haveJobserver = true;
+                return makeJobCount > 0 ? makeJobCount : os::getProcessorCount();
+            }
+
+            fprintf(stderr, "Warning: the jobserver in MAKEFLAGS is not available, running one job at a time. Prefix the make rule that runs rsc with '+'.\n");
+            return 1;
+        }
+    }
+    
+    if (!jobCount) jobCount = os::getProcessorCount();
+
+    if (os::createJobserver(jobCount - 1, &jobserver)) {
+        haveJobserver = true;
+
+        char *flags = mprintf("%s -j%d --jobserver-auth=%s", makeflags ? makeflags : "", jobCount, jobserver.auth);
+        os::setEnvironmentVariable("MAKEFLAGS", flags);
+        free(flags);
+    }
+
+    return jobCount;
+}
+
+JobScheduler::~JobScheduler() {
+    for (int i = 0; i < jobs.count; i++) {
+        delete jobs[i];
+    }
+}
+
+Job *JobScheduler::add(char *description, CommandLine *commandLine) {
+    Job *job = new Job();
+    job->order = jobs.count;
+    job->description = description;
+    job->commandLine = commandLine;
+    jobs.add(job);
+    return job;
+}
+
+void JobScheduler::addDependency(Job *job, Job *dependency) {
+    dependency->dependents.add(job);
+    job->pendingDependencies++;
+}
+
+static int computeChainLength(Job *job) {
+    if (job->chainLength) return job->chainLength;
+
+    int longest = 0;
+    for (int i = 0; i < job->dependents.count; i++) {
+        int length = computeChainLength(job->dependents[i]);
+        if (length > longest) longest = length;
+    }
+    
+    job->chainLength = longest + 1;
+    return job->chainLength;
+}
+
+static bool runsBefore(Job *a, Job *b) {
+    if (a->chainLength != b->chainLength) return a->chainLength > b->chainLength;
+    return a->order < b->order;
+}
+
+// Binary heap of the ready jobs, the one to run next on top.
+static void pushReady(DynamicArray<Job *> &heap, Job *job) {
+    heap.add(job);
+    
+    int i = heap.count - 1;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!runsBefore(heap[i], heap[parent])) break;
+        
+        Job *t = heap[i]; heap[i] = heap[parent]; heap[parent] = t;
+        i = parent;
+    }
+}
+
+static Job *popReady(DynamicArray<Job *> &heap) {
+    Job *top = heap[0];
+    heap[0] = heap[heap.count - 1];
+    heap.count--;
+
+    int i = 0;
+    while (true) {
+        int best = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < heap.count && runsBefore(heap[left], heap[best])) best = left;
+        if (right < heap.count && runsBefore(heap[right], heap[best])) best = right;
+        if (best == i) break;
+
+        Job *t = heap[i]; heap[i] = heap[best]; heap[best] = t;
+        i = best;
+    }
+    
+    return top;
+}
+
+static void releaseDependents(Job *job, DynamicArray<Job *> &ready) {
+    for (int i = 0; i < job->dependents.count; i++) {
+        Job *dependent = job->dependents[i];
+        dependent->pendingDependencies--;
+        if (dependent->pendingDependencies == 0) {
+            pushReady(ready, dependent);
+        }
+    }
+}
+
+bool JobScheduler::run() {
+    int maxRunning = maxRunningJobs > 0 ? maxRunningJobs : 1;
+
+    DynamicArray<Job *> ready;
+    DynamicArray<Job *> running;
+    DynamicArray<os::Process *> processes;
+
+    // One job runs on the token we own anyway, every other one on a token
+    // from the jobserver, handed back as soon as it's done.
+    DynamicArray<char> tokens;
+
+    // Which slots are taken by a running job, so every job gets a lane of
+    // its own in the trace.
+    DynamicArray<bool> slotsTaken;
+    for (int i = 0; i < maxRunning; i++) {
+        slotsTaken.add(false);
+    }
+
+    for (int i = 0; i < jobs.count; i++) {
+        computeChainLength(jobs[i]);
+    }
+    for (int i = 0; i < jobs.count; i++) {
+        if (jobs[i]->pendingDependencies == 0) {
+            pushReady(ready, jobs[i]);
+        }
+    }
+    
+    int finishedCount = 0;
+    bool failed = false;
+
+    // The console writes to stdout directly, so whatever printf still has
+    // buffered has to come out first.
+    fflush(stdout);
+    
+    while (true) {
+        bool waitingForToken = false;
+        
+        while (!failed && ready.count && running.count < maxRunning) {
+            if (haveJobserver && running.count > tokens.count) {
+                char token;
+                if (!os::tryAcquireJobToken(&jobserver, &token)) {
+                    waitingForToken = true;
+                    break;
+                }
+                tokens.add(token);
+            }
+            
+            Job *job = popReady(ready);
+
+            if (!job->commandLine || (job->prepare && !job->prepare(job))) {
+                job->finished = true;
+                job->skipped = true;
+                finishedCount++;
+                releaseDependents(job, ready);
+                continue;
+            }
+
+            if (!os::startProcess(job->commandLine->getArgv(), &job->process, job->captureOutput)) {
+                fprintf(stderr, "Failed to start '%s'\n", job->commandLine->toString()); // @Leak
+                job->exitCode = -1;
+                failed = true;
+                break;
+            }
+            running.add(job);
+
+            job->startTime = os::getTime();
+            for (int i = 0; i < slotsTaken.count; i++) {
+                if (!slotsTaken[i]) {
+                    slotsTaken[i] = true;
+                    job->slot = i + 1;
+                    break;
+                }
+            }
+            trace.addCounter("Jobs in flight", job->startTime, running.count);
+        }
+
+        // Tokens taken for jobs that finished, or that prepare skipped,
+        // go back right away.
+        while (tokens.count && tokens.count >= running.count) {
+            os::releaseJobToken(&jobserver, tokens[tokens.count - 1]);
+            tokens.count--;
+        }
+
+        if (!running.count) break;
+
+        processes.count = 0;
+        for (int i = 0; i < running.count; i++) {
+            processes.add(&running[i]->process);
+        }
+
+        // While there's output the terminal didn't take yet, or a job that
+        // could start once someone else returns a token, wake up now and then
+        // to check again.
+        int index = os::waitForAnyProcess(processes.data, processes.count, console.hasPending() || waitingForToken ? 10 : -1);
+        console.flush(false);
+        if (index == -1) continue;
+        if (index < 0) {
+            fprintf(stderr, "Failed to wait for child processes\n");
+            for (int i = 0; i < running.count; i++) {
+                os::killProcess(&running[i]->process);
+            }
+            for (int i = 0; i < tokens.count; i++) {
+                os::releaseJobToken(&jobserver, tokens[i]);
+            }
+            return false;
+        }
+
+        Job *job = running[index];
+        running[index] = running[running.count - 1];
+        running.count--;
+        
+        job->finished = true;
+        job->exitCode = job->process.exitCode;
+        finishedCount++;
+
+        job->endTime = os::getTime();
+        if (job->slot) slotsTaken[job->slot - 1] = false;
+        trace.addSpan(job->startTime, job->endTime, job->slot, job->category, "%s", job->description);
+        trace.addCounter("Jobs in flight", job->endTime, running.count);
+        
+        if (job->finish) job->finish(job);
+
+        if (job->captureOutput) {
+            console.writeToolOutput(job->process.output.data, job->process.output.count);
+            console.writeToolOutput(job->process.errorOutput.data, job->process.errorOutput.count);
+        }
+        
+        if (job->exitCode != 0) {
+            console.printf("'%s' failed with exit code %d\n", job->description, job->exitCode);
+            failed = true;
+        } else {
+            releaseDependents(job, ready);
+        }
+    }
+
+    console.flush(true);
+    return !failed && finishedCount == jobs.count;
+}
+
+static double getDuration(Job *job) {
+    if (!job->startTime || !job->endTime) return 0.0; // Skipped or never started.
+    return job->endTime - job->startTime;
+}
+
+// The time the longest chain starting at job took to run. next gets the
+// dependent that chain continues with.
+static double computeCriticalTime(Job *job, DynamicArray<double> &times, DynamicArray<Job *> &next) {
+    if (times[job->order] >= 0.0) return times[job->order];
+
+    double longest = 0.0;
+    Job *longestDependent = NULL;
+    for (int i = 0; i < job->dependents.count; i++) {
+        double time = computeCriticalTime(job->dependents[i], times, next);
+        if (time > longest) {
+            longest = time;
+            longestDependent = job->dependents[i];
+        }
+    }
+
+    times[job->order] = getDuration(job) + longest;
+    next[job->order] = longestDependent;
+    return times[job->order];
+}
+
+static int compareDurations(const void *a, const void *b) {
+    double durationA = getDuration(*(Job **)a);
+    double durationB = getDuration(*(Job **)b);
+    if (durationA != durationB) return durationA > durationB ? -1 : 1;
+    return (*(Job **)a)->order - (*(Job **)b)->order;
+}
+
+void JobScheduler::printReport(int slowestCount) {
+    DynamicArray<double> times;
+    DynamicArray<Job *> next;
+    DynamicArray<Job *> compiles;
+    double firstStart = 0.0;
+    double lastEnd = 0.0;
+    double work = 0.0;
+    for (int i = 0; i < jobs.count; i++) {
+        Job *job = jobs[i];
+        times.add(-1.0);
+        next.add(NULL);
+
+        double duration = getDuration(job);
+        if (duration <= 0.0) continue;
+
+        if (!firstStart || job->startTime < firstStart) firstStart = job->startTime;
+        if (job->endTime > lastEnd) lastEnd = job->endTime;
+        work += duration;
+        if (stringsMatch(job->category, "compile")) compiles.add(job);
+    }
+
+    if (!work) {
+        printf("No jobs ran, nothing to report.\n");
+        return;
+    }
+    double wallTime = lastEnd - firstStart;
+
+    Job *first = NULL;
+    double criticalTime = 0.0;
+    for (int i = 0; i < jobs.count; i++) {
+        double time = computeCriticalTime(jobs[i], times, next);
+        if (time > criticalTime) {
+            criticalTime = time;
+            first = jobs[i];
+        }
+    }
+
+    printf("Critical path: %.2fs of the %.2fs jobs ran for\n", criticalTime, wallTime);
+    for (Job *job = first; job; job = next[job->order]) {
+        if (getDuration(job) <= 0.0) continue;
+        printf("    %8.2fs  %-8s %s\n", getDuration(job), job->category, job->description);
+    }
+
+    qsort(compiles.data, compiles.count, sizeof(Job *), compareDurations);
+    int shown = compiles.count < slowestCount ? compiles.count : slowestCount;
+    if (shown) {
+        printf("Slowest translation units:\n");
+        for (int i = 0; i < shown; i++) {
+            printf("    %8.2fs  %s\n", getDuration(compiles[i]), compiles[i]->description);
+        }
+    }
+
+    // How much of what -j allowed was actually used. The rest went to
+    // waiting on dependencies, or on the jobserver.
+    int slots = maxRunningJobs > 0 ? maxRunningJobs : 1;
+    double efficiency = wallTime > 0.0 ? work / (wallTime * slots) : 1.0;
+    printf("Parallel efficiency: %.0f%% of %d job slot%s (%.2fs of work in %.2fs)\n",
+           efficiency * 100.0, slots, slots == 1 ? "" : "s", work, wallTime);
+}
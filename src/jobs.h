@@ -0,0 +1,75 @@
+#pragma once
+
+#include "dynamic_array.h"
+#include "utils.h"
+#include "os.h"
+
+struct Job {
+    char *description = NULL;
+    char *category = "job"; // What kind of job it is in traces and reports, e.g. "compile".
+    CommandLine *commandLine = NULL; // NULL for jobs that only order others.
+
+    // The output is collected while the job runs and printed in one piece
+    // once it finished, after finish had a chance to look at it.
+    bool captureOutput = false;
+
+    // Called once every dependency succeeded, right before the job would be
+    // started. Returning false skips the job, which then counts as succeeded.
+    bool (*prepare)(Job *job) = NULL;
+
+    // Called when the process exited, successfully or not. May edit
+    // process.output before it gets printed.
+    void (*finish)(Job *job) = NULL;
+    
+    void *userData = NULL;
+
+    DynamicArray<Job *> dependents;
+    int pendingDependencies = 0;
+
+    // Filled in by run(): the number of jobs on the longest chain that
+    // starts here. Ready jobs with longer chains are started first.
+    int chainLength = 0;
+    int order = 0;
+
+    os::Process process = {};
+    bool finished = false;
+    bool skipped = false;
+    int exitCode = 0;
+
+    // When the process ran, in os::getTime() seconds, and which of the
+    // maxRunningJobs slots, counting from 1, it ran in.
+    double startTime = 0.0;
+    double endTime = 0.0;
+    int slot = 0;
+};
+
+// Joins the GNU make jobserver named in MAKEFLAGS, unless jobCount was given
+// explicitly (0 means it wasn't), in which case a pool of our own with
+// jobCount tokens is set up and exported in MAKEFLAGS for the tools we run.
+// Either way every job past the first has to take a token from the pool, so
+// a whole tree of nested builds stays within one -j. Returns the number of
+// jobs to run at most.
+int setUpJobserver(int jobCount);
+
+// Runs a graph of external commands, at most maxRunningJobs at a time. A job
+// becomes ready once all of its dependencies succeeded. Of the ready jobs
+// the one heading the longest chain of waiting jobs is started first, so
+// the tail of the build (links waiting on libraries waiting on compiles)
+// isn't left for last; ties go in the order the jobs were added. As soon as one job fails no new
+// jobs are started, the ones already running are waited for and run()
+// returns false.
+struct JobScheduler {
+    int maxRunningJobs = 1;
+    DynamicArray<Job *> jobs;
+
+    ~JobScheduler();
+
+    Job *add(char *description, CommandLine *commandLine);
+    void addDependency(Job *job, Job *dependency);
+    bool run();
+
+    // After run(), prints the chain of jobs that bounded the build by how
+    // long they actually took, the slowest compiles, and how much of the
+    // maxRunningJobs slots the build kept busy.
+    void printReport(int slowestCount);
+};
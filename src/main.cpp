@@ -1,13 +1,26 @@
 #include "utils.h"
 #include "main.h"
 #include "os.h"
+#include "compile_cache.h"
+#include "jobs.h"
+#include "trace.h"
+#include "stats.h"
+
+#include "include_graph.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How long things have to be quiet after a change before --watch builds.
+#define WATCH_DEBOUNCE_MILLISECONDS 100
 
 GlobalData globalData = {};
 
-bool parseRscFile(char *filepath, char *data);
-void executeMSVCForProject(RscProject *project, RscConfiguration *cfg, u64 rscModtime);
+bool parseRscFile(char *filepath, char *data, i64 length);
+bool executeProjects(DynamicArray<RscProject *> &projects, DynamicArray<RscConfiguration *> &configurations, u64 rscModtime);
+bool reportHeaders(DynamicArray<RscProject *> &projects, DynamicArray<RscConfiguration *> &configurations);
+void getBuildInputs(DynamicArray<char *> &paths);
 
 static bool isValid(GlobalData data) {
     return ((data.filename != NULL) &&
@@ -15,7 +28,7 @@ static bool isValid(GlobalData data) {
 }
 
 static void printUsage() {
-    printf("Usage: rsc <filename>.rsc -configuration:<ConfigurationName> [-B]\n");
+    printf("Usage: rsc <filename>.rsc -configuration:<ConfigurationName> [-B] [-v] [-j <jobs>] [--content-hash] [--cache=<dir>] [--cache-size=<MB>] [--trace=<file>] [--report[=<count>]] [--header-report[=<count>]] [--stats=json] [--watch]\n");
 }
 
 static bool parseCommandLineArguments(int argc, char **argv) {
@@ -43,31 +56,136 @@ static bool parseCommandLineArguments(int argc, char **argv) {
     stringToCopy += getStringLength("-configuration:");
     globalData.configurationNameToBuild = copyString(stringToCopy);
     
-    if (argc == 4) {
-        if (stringsMatch(argv[3], "-B")) {
+    for (int i = 3; i < argc; i++) {
+        char *arg = argv[i];
+        
+        if (stringsMatch(arg, "-B")) {
             globalData.rebuild = true;
+        } else if (stringsMatch(arg, "-v") || stringsMatch(arg, "--verbose")) {
+            globalData.verbose = true;
+        } else if (stringsMatch(arg, "--content-hash")) {
+            globalData.contentHash = true;
+        } else if (startsWith(arg, "--cache=")) {
+            globalData.cacheDirectory = copyString(arg + getStringLength("--cache="));
+        } else if (startsWith(arg, "--cache-size=")) {
+            char *size = arg + getStringLength("--cache-size=");
+            globalData.cacheMaxSize = (u64)atoll(size) * 1024 * 1024;
+            if (!globalData.cacheMaxSize) {
+                fprintf(stderr, "Invalid cache size '%s'.\n", size);
+                printUsage();
+                return false;
+            }
+        } else if (startsWith(arg, "--trace=")) {
+            globalData.traceFile = copyString(arg + getStringLength("--trace="));
+            if (!globalData.traceFile[0]) {
+                fprintf(stderr, "--trace expects the file to write the trace to.\n");
+                printUsage();
+                return false;
+            }
+            trace.enabled = true;
+        } else if (stringsMatch(arg, "--report")) {
+            globalData.reportCount = 10;
+        } else if (startsWith(arg, "--report=")) {
+            char *count = arg + getStringLength("--report=");
+            globalData.reportCount = atoi(count);
+            if (globalData.reportCount <= 0) {
+                fprintf(stderr, "Invalid number of translation units to report '%s'.\n", count);
+                printUsage();
+                return false;
+            }
+        } else if (stringsMatch(arg, "--watch")) {
+            globalData.watch = true;
+        } else if (startsWith(arg, "--stats=")) {
+            char *format = arg + getStringLength("--stats=");
+            if (!stringsMatch(format, "json")) {
+                fprintf(stderr, "Unknown stats format '%s', only json is supported.\n", format);
+                printUsage();
+                return false;
+            }
+            stats.enabled = true;
+        } else if (stringsMatch(arg, "--header-report")) {
+            globalData.headerReportCount = 20;
+        } else if (startsWith(arg, "--header-report=")) {
+            char *count = arg + getStringLength("--header-report=");
+            globalData.headerReportCount = atoi(count);
+            if (globalData.headerReportCount <= 0) {
+                fprintf(stderr, "Invalid number of headers to report '%s'.\n", count);
+                printUsage();
+                return false;
+            }
+        } else if (startsWith(arg, "-j")) {
+            char *count = arg + 2;
+            if (!count[0]) {
+                if (i + 1 >= argc) {
+                    fprintf(stderr, "-j expects the number of parallel jobs.\n");
+                    printUsage();
+                    return false;
+                }
+                count = argv[++i];
+            }
+
+            globalData.jobCount = atoi(count);
+            if (globalData.jobCount <= 0) {
+                fprintf(stderr, "Invalid number of jobs '%s'.\n", count);
+                printUsage();
+                return false;
+            }
+        } else {
+            fprintf(stderr, "Unknown option '%s'.\n", arg);
+            printUsage();
+            return false;
         }
     }
 
+    globalData.jobCount = setUpJobserver(globalData.jobCount);
+
+    if (!globalData.cacheDirectory) {
+        char *directory = getenv("RSC_CACHE_DIR");
+        if (directory && directory[0]) globalData.cacheDirectory = copyString(directory);
+    }
+    if (!globalData.cacheMaxSize) {
+        char *size = getenv("RSC_CACHE_SIZE");
+        if (size) globalData.cacheMaxSize = (u64)atoll(size) * 1024 * 1024;
+        if (!globalData.cacheMaxSize) globalData.cacheMaxSize = 5ull * 1024 * 1024 * 1024;
+    }
+
+    if (globalData.cacheDirectory) {
+        os::makeDirectoryIfNotExist(globalData.cacheDirectory);
+        if (!os::directoryExists(globalData.cacheDirectory)) {
+            fprintf(stderr, "Failed to create cache directory '%s'.\n", globalData.cacheDirectory);
+            return false;
+        }
+        compileCache.directory = globalData.cacheDirectory;
+        compileCache.maxSize = globalData.cacheMaxSize;
+    }
+
     return true;
 }
 
-int main(int argc, char **argv) {
-    if (!parseCommandLineArguments(argc, argv)) return 1;
-    Assert(isValid(globalData));
-
-    extern double rscStartTime;
-    rscStartTime = os::getTime();
+// Parses the .rsc file into globalData and picks the configuration of every
+// project that gets built.
+static bool loadProjects(DynamicArray<RscConfiguration *> &configurations, u64 *rscModtime) {
+    double parseStartTime = os::getTime();
     
-    char *fileData = (char *)os::readEntireFile(globalData.filename);
-    if (!fileData) return 1;
+    // Everything the parser keeps is copied out of the file.
+    os::MappedFile rscFile;
+    if (!os::mapFile(globalData.filename, &rscFile)) {
+        fprintf(stderr, "Failed to read '%s'.\n", globalData.filename);
+        return false;
+    }
     
-    if (!parseRscFile(globalData.filename, fileData)) {
-        return 1;
+    bool parsed = parseRscFile(globalData.filename, (char *)rscFile.data, rscFile.length);
+    os::unmapFile(&rscFile);
+    if (!parsed) {
+        return false;
     }
+    trace.addSpan(parseStartTime, os::getTime(), 0, "rsc", "Parse %s", globalData.filename);
+    stats.addPhaseTime("parse", parseStartTime, os::getTime());
 
-    u64 rscModtime = 0;
-    os::getLastWriteTime(globalData.filename, &rscModtime);
+    double resolveStartTime = os::getTime();
+
+    *rscModtime = 0;
+    os::getLastWriteTime(globalData.filename, rscModtime);
 
     char *currentConfigurationName = NULL;
     char *cfgName = copyStringLowercased(globalData.configurationNameToBuild);
@@ -83,7 +201,7 @@ int main(int argc, char **argv) {
     
     if (!currentConfigurationName) {
         fprintf(stderr, "ERROR: configuration passed to -configuration: isn't a valid configuration\n");
-        return 1;
+        return false;
     }
     
     for (int i = 0; i < globalData.projects.count; i++) {
@@ -98,8 +216,180 @@ int main(int argc, char **argv) {
             }
         }
 
-        executeMSVCForProject(project, currentConfiguration, rscModtime);
+        configurations.add(currentConfiguration);
+    }
+    trace.addSpan(resolveStartTime, os::getTime(), 0, "rsc", "Resolve configurations");
+    stats.addPhaseTime("resolveConfigurations", resolveStartTime, os::getTime());
+
+    return true;
+}
+
+static bool build(DynamicArray<RscConfiguration *> &configurations, u64 rscModtime) {
+    bool success;
+    if (globalData.headerReportCount) {
+        success = reportHeaders(globalData.projects, configurations);
+    } else {
+        success = executeProjects(globalData.projects, configurations, rscModtime);
+    }
+
+    if (globalData.traceFile && !trace.write(globalData.traceFile)) {
+        fprintf(stderr, "Failed to write trace '%s'.\n", globalData.traceFile);
+    }
+
+    if (stats.enabled) {
+        extern double rscStartTime;
+        stats.print(os::getTime() - rscStartTime);
+    }
+    
+    return success;
+}
+
+// Files that are gone are left to the build to complain about; a
+// dependency database can still mention headers nothing includes anymore.
+static void addTrackedFile(char *path, StringTable<bool> &tracked, DynamicArray<char *> &ownedPaths, os::FileWatcher *watcher) {
+    os::FileInfo info;
+    if (!os::getCachedFileInfo(path, &info) || info.isDirectory) return;
+    
+    char *normalized = copyNormalizedPath(path);
+    bool added = false;
+    *tracked.add(normalized, &added) = true;
+    if (!added) {
+        delete[] normalized;
+        return;
+    }
+    ownedPaths.add(normalized);
+
+    char *directory;
+    char *slash = strrchr(normalized, '/');
+    if (!slash) directory = mprintf(".");
+    else if (slash == normalized) directory = mprintf("/");
+    else directory = mprintf("%.*s", (int)(slash - normalized), normalized);
+    
+    if (!os::watchDirectory(watcher, directory)) {
+        fprintf(stderr, "Failed to watch '%s' for changes.\n", directory);
+    }
+    free(directory);
+}
+
+// --watch: after the first build everything parsed, stat'ed and scanned
+// stays in memory, and rsc builds again whenever the .rsc file, a source or
+// a header one of them includes changes. A burst of saves becomes a single
+// build, and only the files that changed are looked at again.
+static int watch(DynamicArray<RscConfiguration *> &configurations, u64 rscModtime) {
+    os::FileWatcher watcher;
+    if (!os::startFileWatcher(&watcher)) {
+        fprintf(stderr, "Failed to watch for file changes.\n");
+        return 1;
+    }
+
+    char *rscPath = copyNormalizedPath(globalData.filename);
+    
+    while (true) {
+        // Whatever the last build ended up depending on.
+        StringTable<bool> tracked;
+        DynamicArray<char *> ownedPaths;
+        addTrackedFile(rscPath, tracked, ownedPaths, &watcher);
+        for (int i = 0; i < globalData.projects.count; i++) {
+            RscProject *project = globalData.projects[i];
+            for (int j = 0; j < project->files.count; j++) {
+                addTrackedFile(project->files[j], tracked, ownedPaths, &watcher);
+            }
+        }
+        DynamicArray<char *> inputs;
+        getIncludeGraphFiles(inputs);
+        getBuildInputs(inputs);
+        for (int i = 0; i < inputs.count; i++) {
+            addTrackedFile(inputs[i], tracked, ownedPaths, &watcher);
+        }
+
+        printf("Watching %d files for changes...\n", tracked.count);
+        fflush(stdout);
+
+        // Changes to files nobody depends on, like the objects just built,
+        // don't start a build. After the first one that does, wait until
+        // things have been quiet for a moment.
+        StringTable<bool> seen;
+        DynamicArray<char *> eventPaths;
+        DynamicArray<char *> changedPaths;
+        bool rscChanged = false;
+        int timeout = -1;
+        while (true) {
+            DynamicArray<char *> events;
+            if (!os::waitForFileChanges(&watcher, timeout, events)) {
+                fprintf(stderr, "Waiting for file changes failed.\n");
+                return 1;
+            }
+            if (!events.count && timeout >= 0) break;
+            
+            for (int i = 0; i < events.count; i++) {
+                char *path = copyNormalizedPath(events[i]);
+                free(events[i]);
+
+                bool added = false;
+                *seen.add(path, &added) = true;
+                if (!added) {
+                    delete[] path;
+                    continue;
+                }
+                eventPaths.add(path);
+                
+                if (!tracked.find(path)) continue;
+                if (stringsMatch(path, rscPath)) rscChanged = true;
+                changedPaths.add(path);
+                timeout = WATCH_DEBOUNCE_MILLISECONDS;
+            }
+        }
+
+        extern double rscStartTime;
+        rscStartTime = os::getTime();
+        stats.reset();
+        trace.reset();
+
+        // Untracked files count here too: a header that was just created
+        // has to show up in the cached listing of its directory by the time
+        // something includes it.
+        for (int i = 0; i < eventPaths.count; i++) {
+            os::invalidateCachedFileInfo(eventPaths[i]);
+        }
+        invalidateIncludeGraphs(changedPaths);
+        
+        for (int i = 0; i < eventPaths.count; i++) delete[] eventPaths[i];
+        for (int i = 0; i < ownedPaths.count; i++) delete[] ownedPaths[i];
+
+        if (rscChanged) {
+            globalData.configurationNames.count = 0; // @Leak
+            globalData.projects.count = 0; // @Leak
+            configurations.count = 0;
+            if (!loadProjects(configurations, &rscModtime)) {
+                // Try again once it's been fixed.
+                globalData.projects.count = 0;
+                continue;
+            }
+        }
+        
+        build(configurations, rscModtime);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (!parseCommandLineArguments(argc, argv)) return 1;
+    Assert(isValid(globalData));
+
+    extern double rscStartTime;
+    rscStartTime = os::getTime();
+
+    DynamicArray<RscConfiguration *> configurations;
+    u64 rscModtime = 0;
+    if (!loadProjects(configurations, &rscModtime)) {
+        if (!globalData.watch) return 1;
+        globalData.projects.count = 0; // Only the .rsc file is watched then.
+        return watch(configurations, rscModtime);
+    }
+
+    bool success = build(configurations, rscModtime);
+    if (globalData.watch) {
+        return watch(configurations, rscModtime);
     }
     
-    return 0;
+    return success ? 0 : 1;
 }
@@ -13,6 +13,13 @@ enum RuntimeType {
     RuntimeType_Release,
 };
 
+enum ToolchainType {
+    ToolchainType_Auto, // Whatever compiler is installed.
+    ToolchainType_MSVC,
+    ToolchainType_GCC,
+    ToolchainType_Clang,
+};
+
 struct RscConfiguration {
     char *name = NULL;
     char *lowercasedName = NULL;
@@ -28,8 +35,10 @@ struct RscConfiguration {
     DynamicArray<char *> defines;
 
     DynamicArray<char *> includeDirs;
+    DynamicArray<char *> externalIncludeDirs; // Never change, so their headers are never stat'ed.
     DynamicArray<char *> libDirs;
     DynamicArray<char *> libs;
+    DynamicArray<char *> dependsOn; // Names of projects that have to be built first. Their static libraries get linked in.
 
     char *pchheader = NULL;
     char *pchsource = NULL;
@@ -41,6 +50,15 @@ struct RscConfiguration {
     bool staticRuntime = true;
     bool staticRuntimeSet = false;
     RuntimeType runtimeType = RuntimeType_Debug;
+    ToolchainType toolchain = ToolchainType_Auto;
+
+    // Compile the files in batches, each batch being one generated .cpp that
+    // includes them all.
+    bool unityBuild = false;
+    bool unityBuildSet = false;
+    int unityBatchSize = 16;
+    bool unityBatchSizeSet = false;
+    DynamicArray<char *> unityExclude; // Files that are always compiled on their own.
 };
 
 struct RscProject : public RscConfiguration {
@@ -51,6 +69,15 @@ struct GlobalData {
     char *filename = NULL;
     char *configurationNameToBuild = NULL;
     bool rebuild = false;
+    bool verbose = false; // Print full command lines.
+    int jobCount = 0; // 0 means one job per available CPU, or as many as the make we run under allows.
+    bool contentHash = false; // Files only count as changed when their contents hash differently.
+    char *cacheDirectory = NULL; // Compile cache, disabled when NULL.
+    u64 cacheMaxSize = 0;
+    char *traceFile = NULL; // Chrome trace event JSON of the build goes here.
+    int reportCount = 0; // Print the critical path and this many of the slowest compiles, 0 for no report.
+    int headerReportCount = 0; // Rank headers by parse cost and print this many of them instead of building, 0 to build.
+    bool watch = false; // Build again whenever a file the build depends on changes.
     
     int version = -1;
     
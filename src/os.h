@@ -1,20 +1,178 @@
 #pragma once
 
 #include "defines.h"
+#include "dynamic_array.h"
 
 namespace os {
 
     void *readEntireFile(char *filepath, i64 *lengthPointer = NULL);
+    bool writeEntireFile(char *filepath, void *data, i64 length);
+
+    // A file's contents mapped read-only into memory rather than copied.
+    // Not NUL-terminated, and data is NULL for an empty file. The file must
+    // not be truncated while it's mapped.
+    struct MappedFile {
+        void *data;
+        i64 length;
+    };
+
+    bool mapFile(char *filepath, MappedFile *file);
+    void unmapFile(MappedFile *file);
 
     bool fileExists(char *filepath);
     bool getLastWriteTime(char *filepath, u64 *outTime);
+    bool getFileInfo(char *filepath, u64 *outTime, u64 *outSize);
     bool deleteFile(char *file);
-        
+
     bool directoryExists(char *filepath);
+    char *getCurrentDirectory(); // malloc'ed.
     bool makeDirectoryIfNotExist(char *dir);
 
+    struct DirectoryEntry {
+        char *name;
+        bool isDirectory;
+
+        // Filled in where listing the directory returns them for free (Windows).
+        bool hasInfo;
+        u64 modtime;
+        u64 size;
+    };
+
+    // Lists dir without "." and "..". Names are allocated with copyString.
+    bool listDirectory(char *dir, DynamicArray<DirectoryEntry> &entries);
+
+    struct FileInfo {
+        bool exists;
+        bool isDirectory;
+        u64 modtime;
+        u64 size;
+    };
+
+    // Metadata cache for files that don't change while we run (sources and
+    // headers, not our outputs). The first query in a directory lists the
+    // whole directory once; after that existence checks are hash probes and
+    // modtime/size come from memory.
+    bool getCachedFileInfo(char *filepath, FileInfo *info);
+    // Existence from the directory listing only, never a stat of the file.
+    bool getCachedFileExists(char *filepath);
+    void invalidateCachedFileInfo(char *filepath);
+
+    struct StatCacheCounters {
+        u64 hits;
+        u64 misses;
+        u64 directoriesListed;
+        u64 filesStated;
+    };
+
+    StatCacheCounters getStatCacheCounters();
+
+    // What this process asked of the file system and the OS, for --stats.
+    struct IoCounters {
+        u64 filesStated; // Metadata lookups that reached the OS, from the stat cache or not.
+        u64 filesRead;
+        u64 bytesRead;
+        u64 filesMapped;
+        u64 bytesMapped;
+        u64 processesStarted;
+    };
+
+    IoCounters getIoCounters();
+
+    u64 getPeakMemoryUsage(); // Peak resident set size of this process in bytes, 0 if unknown.
+
     double getTime();
 
+    // Without wait only writes as much of data to stdout as can go without
+    // waiting for a slow terminal or a full pipe. Returns the number of bytes
+    // written, -1 on error.
+    i64 writeStdout(char *data, i64 length, bool wait);
+
     bool copyFile(char *sourceFile, char *destFile);
-    
+    bool moveFile(char *sourceFile, char *destFile); // Replaces destFile atomically.
+    bool touchFile(char *filepath); // Sets the modtime to now.
+
+    // Looks name up in PATH like the shell would. Returns a malloc'ed path, or
+    // NULL if not found.
+    char *findExecutable(char *name);
+
+    // Number of CPUs this process may actually use, taking affinity masks and
+    // CPU quotas (cgroups on Linux, job objects on Windows) into account.
+    int getProcessorCount();
+
+    struct Process {
+        u64 handle; // pid on Linux, process HANDLE on Windows.
+        i64 pidfd;  // Linux only, -1 if the kernel doesn't have pidfd_open.
+
+        // Read ends of the pipes the child's stdout and stderr go to, -1 when
+        // not captured or once they hit the end.
+        i64 outputPipe;
+        i64 errorPipe;
+        DynamicArray<char> output;
+        DynamicArray<char> errorOutput;
+
+        int exitCode;
+    };
+
+    // Starts argv[0] (looked up in PATH) with the NULL-terminated argv, no
+    // shell involved. With captureOutput the child's stdout and stderr are
+    // collected into process->output and process->errorOutput while we wait
+    // for it, otherwise they go straight to our console.
+    bool startProcess(char **argv, Process *process, bool captureOutput = false);
+
+    // Waits up to timeoutMilliseconds (-1 is forever, 0 just checks) for one
+    // of the processes to exit, reading their captured output meanwhile.
+    // Returns the index of the process that exited, with its exitCode and
+    // all of its output in place, -1 on timeout or -2 if waiting failed. A
+    // process must not be passed again once it was returned.
+    int waitForAnyProcess(Process **processes, int count, int timeoutMilliseconds = -1);
+
+    // Kills the process. It still has to be waited for.
+    bool killProcess(Process *process);
+
+    bool setEnvironmentVariable(char *name, char *value); // Seen by processes started after.
+
+    // A GNU make jobserver: a pool of tokens shared by a whole tree of
+    // processes. Everyone owns one implicit token and takes another one from
+    // the pool for every further job it runs at the same time.
+    struct Jobserver {
+        i64 readHandle;  // Our own non-blocking fd on Linux, the semaphore on Windows.
+        i64 writeHandle; // Linux only.
+        char *auth;      // The --jobserver-auth= value that lets children join.
+    };
+
+    // Joins the pool described by auth ("fifo:<path>" or "<read fd>,<write fd>"
+    // on Linux, a semaphore name on Windows). Fails if the pool isn't actually
+    // there, e.g. because make didn't pass the pipe on to us.
+    bool connectJobserver(char *auth, Jobserver *jobserver);
+
+    // Creates a pool holding tokenCount tokens that processes we start can join.
+    bool createJobserver(int tokenCount, Jobserver *jobserver);
+
+    // Takes a token from the pool without waiting, false if there's none.
+    bool tryAcquireJobToken(Jobserver *jobserver, char *token);
+    void releaseJobToken(Jobserver *jobserver, char token);
+
+    // Reports changes to the files directly in a set of directories, with
+    // inotify on Linux and ReadDirectoryChangesW on Windows. Directories are
+    // watched rather than files so that editors replacing a file on save
+    // are seen too.
+    struct WatchedDirectory {
+        char *path;
+        i64 handle;     // inotify watch descriptor, the directory's HANDLE on Windows.
+        void *pending;  // Windows only: the read in flight and its buffer.
+    };
+
+    struct FileWatcher {
+        i64 handle; // The inotify instance, an I/O completion port on Windows.
+        DynamicArray<WatchedDirectory> directories;
+    };
+
+    bool startFileWatcher(FileWatcher *watcher);
+    bool watchDirectory(FileWatcher *watcher, char *dir); // Watching the same directory again does nothing.
+
+    // Waits up to timeoutMilliseconds (-1 is forever) for changes and adds
+    // "dir/name" of every file that changed to changedPaths, malloc'ed, the
+    // same file possibly more than once. Returns false if waiting failed.
+    bool waitForFileChanges(FileWatcher *watcher, int timeoutMilliseconds, DynamicArray<char *> &changedPaths);
+
 }
@@ -0,0 +1,765 @@
+#ifdef OS_LINUX
+
+#include "os.h"
+#include "dynamic_array.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+
+extern char **environ;
+
+static os::IoCounters ioCounters;
+
+static void toPosixFilepath(char *filepath, char *posixFilepath, i32 posixFilepathSize) {
+    i32 i = 0;
+    for (; filepath[i] && i < posixFilepathSize - 1; i++) {
+        posixFilepath[i] = filepath[i] == '\\' ? '/' : filepath[i];
+    }
+    posixFilepath[i] = 0;
+}
+
+void *os::readEntireFile(char *filepath, i64 *lengthPointer) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    int fd = open(posixFilepath, O_RDONLY);
+    if (fd < 0) {
+        if (lengthPointer) *lengthPointer = 0;
+        return NULL;
+    }
+    defer { close(fd); };
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        if (lengthPointer) *lengthPointer = 0;
+        return NULL;
+    }
+
+    i64 length = (i64)st.st_size;
+    if (lengthPointer) *lengthPointer = length;
+
+    char *data = (char *)malloc(length + 1);
+
+    i64 bytesRead = 0;
+    while (bytesRead < length) {
+        ssize_t n = read(fd, data + bytesRead, length - bytesRead);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        bytesRead += n;
+    }
+    data[bytesRead] = 0;
+
+    ioCounters.filesRead++;
+    ioCounters.bytesRead += bytesRead;
+
+    return data;
+}
+
+bool os::writeEntireFile(char *filepath, void *data, i64 length) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    int fd = open(posixFilepath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) return false;
+    defer { close(fd); };
+
+    i64 written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, (char *)data + written, length - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += n;
+    }
+
+    return true;
+}
+
+bool os::mapFile(char *filepath, MappedFile *file) {
+    *file = {};
+
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    int fd = open(posixFilepath, O_RDONLY);
+    if (fd < 0) return false;
+    defer { close(fd); }; // The mapping stays valid without it.
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    if (st.st_size == 0) return true; // mmap refuses empty ranges.
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return false;
+
+    file->data = data;
+    file->length = (i64)st.st_size;
+
+    ioCounters.filesMapped++;
+    ioCounters.bytesMapped += (u64)st.st_size;
+    return true;
+}
+
+void os::unmapFile(MappedFile *file) {
+    if (file->data) munmap(file->data, (size_t)file->length);
+    *file = {};
+}
+
+bool os::fileExists(char *filepath) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    ioCounters.filesStated++;
+    struct stat st;
+    return stat(posixFilepath, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool os::directoryExists(char *filepath) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    ioCounters.filesStated++;
+    struct stat st;
+    return stat(posixFilepath, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+char *os::getCurrentDirectory() {
+    return getcwd(NULL, 0);
+}
+
+bool os::makeDirectoryIfNotExist(char *dir) {
+    if (os::directoryExists(dir)) return false;
+
+    char posixFilepath[4096];
+    toPosixFilepath(dir, posixFilepath, ArrayCount(posixFilepath));
+
+    // Create every missing parent along the way, like mkdir -p.
+    for (char *at = posixFilepath + 1; *at; at++) {
+        if (*at == '/') {
+            *at = 0;
+            mkdir(posixFilepath, 0755);
+            *at = '/';
+        }
+    }
+    mkdir(posixFilepath, 0755);
+
+    return true;
+}
+
+static u64 toModtime(struct statx_timestamp timestamp) {
+    return (u64)timestamp.tv_sec * 1000000000ull + (u64)timestamp.tv_nsec;
+}
+
+// The layout getdents64 fills in; glibc doesn't declare it.
+struct LinuxDirent64 {
+    u64 d_ino;
+    i64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Reads the directory with raw getdents64 calls into one large buffer, which
+// takes far fewer syscalls than readdir on big directories. Entries of
+// unknown type or symlinks are resolved with statx, whose result is kept
+// since we paid for it anyway.
+bool os::listDirectory(char *dir, DynamicArray<os::DirectoryEntry> &entries) {
+    char posixFilepath[4096];
+    toPosixFilepath(dir, posixFilepath, ArrayCount(posixFilepath));
+
+    int fd = open(posixFilepath, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd < 0) return false;
+    defer { close(fd); };
+
+    char buffer[64 * 1024];
+    while (true) {
+        long bytesRead = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead < 0) return false;
+        if (bytesRead == 0) break;
+
+        for (long offset = 0; offset < bytesRead;) {
+            LinuxDirent64 *dirEntry = (LinuxDirent64 *)(buffer + offset);
+            offset += dirEntry->d_reclen;
+            
+            char *name = dirEntry->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) continue;
+
+            os::DirectoryEntry entry = {};
+            entry.isDirectory = dirEntry->d_type == DT_DIR;
+            
+            if (dirEntry->d_type == DT_UNKNOWN || dirEntry->d_type == DT_LNK) {
+                struct statx stx;
+                if (statx(fd, name, AT_STATX_DONT_SYNC, STATX_TYPE|STATX_MTIME|STATX_SIZE, &stx) != 0) continue;
+                
+                entry.isDirectory = S_ISDIR(stx.stx_mode);
+                entry.hasInfo = true;
+                entry.modtime = toModtime(stx.stx_mtime);
+                entry.size = stx.stx_size;
+            }
+
+            entry.name = copyString(name);
+            entries.add(entry);
+        }
+    }
+
+    return true;
+}
+
+bool os::getLastWriteTime(char *filepath, u64 *outTime) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    ioCounters.filesStated++;
+    struct stat st;
+    if (stat(posixFilepath, &st) != 0) return false;
+
+    if (outTime) *outTime = (u64)st.st_mtim.tv_sec * 1000000000ull + (u64)st.st_mtim.tv_nsec;
+
+    return true;
+}
+
+bool os::getFileInfo(char *filepath, u64 *outTime, u64 *outSize) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    // Only ask for what we need; AT_STATX_DONT_SYNC keeps network filesystems
+    // from revalidating.
+    ioCounters.filesStated++;
+    struct statx stx;
+    if (statx(AT_FDCWD, posixFilepath, AT_STATX_DONT_SYNC, STATX_MTIME|STATX_SIZE, &stx) != 0) return false;
+
+    if (outTime) *outTime = toModtime(stx.stx_mtime);
+    if (outSize) *outSize = (u64)stx.stx_size;
+
+    return true;
+}
+
+bool os::deleteFile(char *filepath) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    return unlink(posixFilepath) == 0;
+}
+
+i64 os::writeStdout(char *data, i64 length, bool wait) {
+    if (wait) {
+        i64 written = 0;
+        while (written < length) {
+            ssize_t result = write(1, data + written, (size_t)(length - written));
+            if (result < 0 && errno == EINTR) continue;
+            if (result < 0) return -1;
+            written += result;
+        }
+        return written;
+    }
+    
+    // O_NONBLOCK belongs to the open file description, which stdout shares
+    // with our shell. Reopening the terminal or pipe gets a description of
+    // our own to make non-blocking. Writes to regular files never wait anyway.
+    static int fd = -1;
+    if (fd < 0) {
+        fd = 1;
+        
+        struct stat st;
+        if (fstat(1, &st) == 0 && (S_ISCHR(st.st_mode) || S_ISFIFO(st.st_mode))) {
+            int reopened = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+            if (reopened >= 0) fd = reopened;
+        }
+    }
+
+    while (true) {
+        ssize_t result = write(fd, data, (size_t)length);
+        if (result >= 0) return result;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+double os::getTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+os::IoCounters os::getIoCounters() {
+    return ioCounters;
+}
+
+u64 os::getPeakMemoryUsage() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (u64)usage.ru_maxrss * 1024; // Kilobytes on Linux.
+}
+
+bool os::copyFile(char *sourceFile, char *destFile) {
+    i64 length = 0;
+    char *data = (char *)os::readEntireFile(sourceFile, &length);
+    if (!data) return false;
+    defer { free(data); };
+
+    return os::writeEntireFile(destFile, data, length);
+}
+
+bool os::moveFile(char *sourceFile, char *destFile) {
+    char posixSourceFilepath[4096];
+    toPosixFilepath(sourceFile, posixSourceFilepath, ArrayCount(posixSourceFilepath));
+
+    char posixDestFilepath[4096];
+    toPosixFilepath(destFile, posixDestFilepath, ArrayCount(posixDestFilepath));
+
+    return rename(posixSourceFilepath, posixDestFilepath) == 0;
+}
+
+bool os::touchFile(char *filepath) {
+    char posixFilepath[4096];
+    toPosixFilepath(filepath, posixFilepath, ArrayCount(posixFilepath));
+
+    return utimensat(AT_FDCWD, posixFilepath, NULL, 0) == 0;
+}
+
+char *os::findExecutable(char *name) {
+    if (strchr(name, '/')) {
+        return access(name, X_OK) == 0 ? mprintf("%s", name) : NULL;
+    }
+
+    char *path = getenv("PATH");
+    if (!path) return NULL;
+
+    char *at = path;
+    while (true) {
+        char *end = strchr(at, ':');
+        i64 length = end ? end - at : getStringLength(at);
+
+        char *candidate = length ? mprintf("%.*s/%s", (int)length, at, name) : mprintf("./%s", name);
+
+        struct stat st;
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+        free(candidate);
+
+        if (!end) break;
+        at = end + 1;
+    }
+
+    return NULL;
+}
+
+static bool readSmallFile(char *filepath, char *buffer, int bufferSize) {
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) return false;
+
+    ssize_t n = read(fd, buffer, bufferSize - 1);
+    close(fd);
+    if (n <= 0) return false;
+
+    buffer[n] = 0;
+    return true;
+}
+
+// Returns the CPU limit imposed by the cgroup we run in, or 0 if there is none.
+static int getCgroupCpuLimit() {
+    char buffer[4096];
+
+    // "/proc/self/cgroup" has a "0::/path" line for cgroup v2, where the quota
+    // lives in cpu.max as "<quota> <period>" or "max <period>", and a
+    // "<id>:cpu,cpuacct:/path" line for the cpu controller of cgroup v1.
+    char cpuMaxPath[4096 + 64] = "/sys/fs/cgroup/cpu.max";
+    char cfsPath[4096 + 64] = "/sys/fs/cgroup/cpu";
+    if (readSmallFile("/proc/self/cgroup", buffer, sizeof(buffer))) {
+        char *at = buffer;
+        while (char *line = consumeNextLine(&at)) {
+            if (startsWith(line, "0::/") && line[4]) {
+                snprintf(cpuMaxPath, sizeof(cpuMaxPath), "/sys/fs/cgroup%s/cpu.max", line + 3);
+                continue;
+            }
+
+            char *controllers = strchr(line, ':');
+            char *path = controllers ? strchr(controllers + 1, ':') : NULL;
+            if (!path || path[1] != '/' || !path[2]) continue;
+            
+            *path = 0;
+            bool isCpu = false;
+            for (char *controller = controllers + 1; controller && *controller;) {
+                char *comma = strchr(controller, ',');
+                i64 length = comma ? comma - controller : getStringLength(controller);
+                if (length == 3 && memcmp(controller, "cpu", 3) == 0) isCpu = true;
+                controller = comma ? comma + 1 : NULL;
+            }
+            if (isCpu) snprintf(cfsPath, sizeof(cfsPath), "/sys/fs/cgroup/cpu%s", path + 1);
+        }
+    }
+
+    if (readSmallFile(cpuMaxPath, buffer, sizeof(buffer)) ||
+        readSmallFile("/sys/fs/cgroup/cpu.max", buffer, sizeof(buffer))) {
+        if (startsWith(buffer, "max")) return 0;
+
+        long long quota = 0, period = 0;
+        if (sscanf(buffer, "%lld %lld", &quota, &period) == 2 && quota > 0 && period > 0) {
+            return (int)((quota + period - 1) / period);
+        }
+        return 0;
+    }
+
+    // cgroup v1, in our own cgroup if it's mounted where we expect it.
+    char quotaPath[4096 + 128];
+    char periodPath[4096 + 128];
+    snprintf(quotaPath, sizeof(quotaPath), "%s/cpu.cfs_quota_us", cfsPath);
+    snprintf(periodPath, sizeof(periodPath), "%s/cpu.cfs_period_us", cfsPath);
+    
+    long long quota = 0, period = 0;
+    if (readSmallFile(quotaPath, buffer, sizeof(buffer)) ||
+        readSmallFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", buffer, sizeof(buffer))) {
+        quota = atoll(buffer);
+    }
+    if (readSmallFile(periodPath, buffer, sizeof(buffer)) ||
+        readSmallFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us", buffer, sizeof(buffer))) {
+        period = atoll(buffer);
+    }
+    if (quota > 0 && period > 0) {
+        return (int)((quota + period - 1) / period);
+    }
+
+    return 0;
+}
+
+int os::getProcessorCount() {
+    int count = 0;
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0) {
+        count = CPU_COUNT(&cpuSet);
+    }
+    if (count <= 0) {
+        count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    int limit = getCgroupCpuLimit();
+    if (limit > 0 && limit < count) count = limit;
+
+    if (count < 1) count = 1;
+    return count;
+}
+
+bool os::startProcess(char **argv, os::Process *process, bool captureOutput) {
+    process->pidfd = -1;
+    process->outputPipe = -1;
+    process->errorPipe = -1;
+    process->output.count = 0;
+    process->errorOutput.count = 0;
+    process->exitCode = 0;
+    
+    // Close-on-exec keeps our ends, and the pipes of the other children
+    // running at the same time, out of this child.
+    int outputPipe[2] = { -1, -1 };
+    int errorPipe[2] = { -1, -1 };
+    if (captureOutput) {
+        if (pipe2(outputPipe, O_CLOEXEC) != 0) return false;
+        if (pipe2(errorPipe, O_CLOEXEC) != 0) {
+            close(outputPipe[0]);
+            close(outputPipe[1]);
+            return false;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (captureOutput) {
+        posix_spawn_file_actions_adddup2(&actions, outputPipe[1], 1);
+        posix_spawn_file_actions_adddup2(&actions, errorPipe[1], 2);
+    }
+
+    pid_t pid = 0;
+    int error = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (captureOutput) {
+        close(outputPipe[1]);
+        close(errorPipe[1]);
+    }
+    if (error != 0) {
+        if (captureOutput) {
+            close(outputPipe[0]);
+            close(errorPipe[0]);
+        }
+        return false;
+    }
+
+    if (captureOutput) {
+        fcntl(outputPipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(errorPipe[0], F_SETFL, O_NONBLOCK);
+        process->outputPipe = outputPipe[0];
+        process->errorPipe = errorPipe[0];
+    }
+    
+#ifdef SYS_pidfd_open
+    process->pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+    process->handle = (u64)pid;
+    ioCounters.processesStarted++;
+    return true;
+}
+
+// Reads whatever is in the pipe right now without blocking.
+static void drainPipe(i64 *pipe, DynamicArray<char> &buffer) {
+    while (*pipe >= 0) {
+        buffer.reserve(buffer.count + 4096);
+        ssize_t result = read((int)*pipe, buffer.data + buffer.count, 4096);
+        if (result > 0) {
+            buffer.count += (int)result;
+            continue;
+        }
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        close((int)*pipe);
+        *pipe = -1;
+    }
+}
+
+static void closeProcessHandles(os::Process *process) {
+    if (process->outputPipe >= 0) close((int)process->outputPipe);
+    if (process->errorPipe >= 0) close((int)process->errorPipe);
+    if (process->pidfd >= 0) close((int)process->pidfd);
+    process->outputPipe = -1;
+    process->errorPipe = -1;
+    process->pidfd = -1;
+}
+
+int os::waitForAnyProcess(os::Process **processes, int count, int timeoutMilliseconds) {
+    if (count <= 0) return -2;
+
+    double deadline = os::getTime() + timeoutMilliseconds / 1000.0;
+    DynamicArray<struct pollfd> fds;
+    
+    while (true) {
+        for (int i = 0; i < count; i++) {
+            os::Process *process = processes[i];
+            
+            int status = 0;
+            pid_t pid = waitpid((pid_t)process->handle, &status, WNOHANG);
+            if (pid != (pid_t)process->handle) continue;
+
+            if (WIFEXITED(status)) {
+                process->exitCode = WEXITSTATUS(status);
+            } else {
+                process->exitCode = 128 + (WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+            }
+
+            // The child is gone, so everything it wrote is in the pipes by now.
+            drainPipe(&process->outputPipe, process->output);
+            drainPipe(&process->errorPipe, process->errorOutput);
+            closeProcessHandles(process);
+            return i;
+        }
+
+        int waitMilliseconds = -1;
+        if (timeoutMilliseconds >= 0) {
+            double remaining = deadline - os::getTime();
+            if (remaining <= 0) return -1;
+            waitMilliseconds = (int)(remaining * 1000.0) + 1;
+        }
+        
+        // Sleep until a child exits or writes something. Without pidfds the
+        // only way to notice an exit is to check again every few milliseconds.
+        fds.count = 0;
+        bool havePidfds = true;
+        for (int i = 0; i < count; i++) {
+            os::Process *process = processes[i];
+            if (process->pidfd >= 0) {
+                fds.add({ (int)process->pidfd, POLLIN, 0 });
+            } else {
+                havePidfds = false;
+            }
+            if (process->outputPipe >= 0) fds.add({ (int)process->outputPipe, POLLIN, 0 });
+            if (process->errorPipe >= 0) fds.add({ (int)process->errorPipe, POLLIN, 0 });
+        }
+        if (!havePidfds && (waitMilliseconds < 0 || waitMilliseconds > 5)) {
+            waitMilliseconds = 5;
+        }
+
+        if (poll(fds.data, (nfds_t)fds.count, waitMilliseconds) < 0 && errno != EINTR) {
+            return -2;
+        }
+
+        for (int i = 0; i < count; i++) {
+            drainPipe(&processes[i]->outputPipe, processes[i]->output);
+            drainPipe(&processes[i]->errorPipe, processes[i]->errorOutput);
+        }
+    }
+}
+
+bool os::killProcess(os::Process *process) {
+    return kill((pid_t)process->handle, SIGKILL) == 0;
+}
+
+bool os::setEnvironmentVariable(char *name, char *value) {
+    return setenv(name, value, 1) == 0;
+}
+
+// Reads of a pipe we share with other processes must not be made
+// non-blocking in place, that would change them for everyone else too.
+// Reopening it through /proc gets an open file description of our own.
+static int reopenNonBlocking(int fd) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+bool os::connectJobserver(char *auth, os::Jobserver *jobserver) {
+    if (startsWith(auth, "fifo:")) {
+        char *path = auth + getStringLength("fifo:");
+        int readFd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (readFd < 0) return false;
+        int writeFd = open(path, O_WRONLY | O_CLOEXEC);
+        if (writeFd < 0) {
+            close(readFd);
+            return false;
+        }
+
+        jobserver->readHandle = readFd;
+        jobserver->writeHandle = writeFd;
+        jobserver->auth = copyString(auth);
+        return true;
+    }
+
+    int readFd, writeFd;
+    if (sscanf(auth, "%d,%d", &readFd, &writeFd) != 2 || readFd < 0 || writeFd < 0) return false;
+
+    // make only leaves the pipe open for commands it knows to be recursive
+    // builds. Otherwise the numbers may be closed, or be some other file.
+    struct stat readStat, writeStat;
+    if (fstat(readFd, &readStat) != 0 || !S_ISFIFO(readStat.st_mode)) return false;
+    if (fstat(writeFd, &writeStat) != 0 || !S_ISFIFO(writeStat.st_mode)) return false;
+
+    int reopened = reopenNonBlocking(readFd);
+    if (reopened < 0) return false;
+
+    jobserver->readHandle = reopened;
+    jobserver->writeHandle = writeFd;
+    jobserver->auth = copyString(auth);
+    return true;
+}
+
+bool os::createJobserver(int tokenCount, os::Jobserver *jobserver) {
+    // A plain pipe handed down by number rather than a named fifo, that's
+    // the form every make version understands. It's left inheritable so the
+    // processes we start can get at it.
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+
+    for (int i = 0; i < tokenCount; i++) {
+        if (write(fds[1], "+", 1) != 1) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+    }
+
+    int reopened = reopenNonBlocking(fds[0]);
+    if (reopened < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    jobserver->readHandle = reopened;
+    jobserver->writeHandle = fds[1];
+    jobserver->auth = mprintf("%d,%d", fds[0], fds[1]);
+    return true;
+}
+
+bool os::tryAcquireJobToken(os::Jobserver *jobserver, char *token) {
+    while (true) {
+        ssize_t result = read((int)jobserver->readHandle, token, 1);
+        if (result == 1) return true;
+        if (result < 0 && errno == EINTR) continue;
+        return false;
+    }
+}
+
+void os::releaseJobToken(os::Jobserver *jobserver, char token) {
+    while (write((int)jobserver->writeHandle, &token, 1) < 0 && errno == EINTR) {}
+}
+
+bool os::startFileWatcher(os::FileWatcher *watcher) {
+    watcher->directories.count = 0;
+    watcher->handle = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    return watcher->handle >= 0;
+}
+
+bool os::watchDirectory(os::FileWatcher *watcher, char *dir) {
+    for (int i = 0; i < watcher->directories.count; i++) {
+        if (stringsMatch(watcher->directories[i].path, dir)) return true;
+    }
+
+    char posixFilepath[4096];
+    toPosixFilepath(dir, posixFilepath, ArrayCount(posixFilepath));
+
+    // IN_ATTRIB because a touch only changes the modtime, which is all rsc
+    // looks at.
+    u32 mask = IN_CLOSE_WRITE|IN_ATTRIB|IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO|IN_ONLYDIR;
+    int wd = inotify_add_watch((int)watcher->handle, posixFilepath, mask);
+    if (wd < 0) return false;
+
+    os::WatchedDirectory directory = {};
+    directory.path = copyString(dir);
+    directory.handle = wd;
+    watcher->directories.add(directory);
+    return true;
+}
+
+bool os::waitForFileChanges(os::FileWatcher *watcher, int timeoutMilliseconds, DynamicArray<char *> &changedPaths) {
+    struct pollfd pollFd = {};
+    pollFd.fd = (int)watcher->handle;
+    pollFd.events = POLLIN;
+
+    int result = poll(&pollFd, 1, timeoutMilliseconds);
+    if (result < 0) return errno == EINTR;
+    if (result == 0) return true;
+
+    // Events are variable size, the buffer has to hold at least one of the
+    // largest kind.
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t bytesRead = read((int)watcher->handle, buffer, sizeof(buffer));
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead < 0 && errno == EAGAIN) return true;
+        if (bytesRead <= 0) return false;
+
+        for (ssize_t offset = 0; offset < bytesRead;) {
+            struct inotify_event *event = (struct inotify_event *)(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            if (!event->len || (event->mask & IN_ISDIR)) continue;
+
+            for (int i = 0; i < watcher->directories.count; i++) {
+                if (watcher->directories[i].handle == event->wd) {
+                    changedPaths.add(mprintf("%s/%s", watcher->directories[i].path, event->name));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "os.h"
+#include "hash_table.h"
+#include "utils.h"
+
+#include <string.h>
+
+struct CachedEntry {
+    bool isDirectory;
+    bool hasInfo;
+    u64 modtime;
+    u64 size;
+};
+
+struct CachedDirectory {
+    bool exists;
+    StringTable<CachedEntry> entries;
+};
+
+// Keys are normalized paths. Windows filesystems are case-insensitive, so
+// there everything is lowercased before it goes into the tables.
+static StringTable<CachedDirectory *> cachedDirectories;
+static os::StatCacheCounters counters;
+
+static void toCacheKey(char *s) {
+#ifdef OS_WINDOWS
+    for (char *at = s; *at; at++) {
+        if (*at >= 'A' && *at <= 'Z') *at += 'a' - 'A';
+    }
+#else
+    (void)s;
+#endif
+}
+
+static void fillCachedDirectory(CachedDirectory *directory, char *dir) {
+    counters.directoriesListed++;
+
+    DynamicArray<os::DirectoryEntry> entries;
+    directory->exists = os::listDirectory(dir, entries);
+    directory->entries.reserve(entries.count);
+    for (int i = 0; i < entries.count; i++) {
+        os::DirectoryEntry *entry = &entries[i];
+        toCacheKey(entry->name);
+
+        CachedEntry *cached = directory->entries.add(entry->name);
+        cached->isDirectory = entry->isDirectory;
+        cached->hasInfo = entry->hasInfo;
+        cached->modtime = entry->modtime;
+        cached->size = entry->size;
+    }
+}
+
+// Splits a normalized path into its directory (in place) and returns the name.
+static char *splitPath(char *path, char **dir) {
+    char *slash = strrchr(path, '/');
+    if (!slash) {
+        *dir = ".";
+        return path;
+    }
+
+    *slash = 0;
+    *dir = path[0] ? path : (char *)"/";
+    return slash + 1;
+}
+
+// The directory listing alone; entries in it may not have their metadata yet.
+static CachedEntry *findCachedEntry(char *filepath, bool *neededSyscall) {
+    char *path = copyNormalizedPath(filepath);
+    defer { delete[] path; };
+    toCacheKey(path);
+
+    char *dir = NULL;
+    char *name = splitPath(path, &dir);
+
+    // Listing the directory answers every later query in it too.
+    CachedDirectory *directory = NULL;
+    CachedDirectory **existing = cachedDirectories.find(dir);
+    if (existing) {
+        directory = *existing;
+    } else {
+        directory = new CachedDirectory();
+        *cachedDirectories.add(copyString(dir)) = directory;
+        fillCachedDirectory(directory, dir);
+        *neededSyscall = true;
+    }
+    
+    return directory->exists ? directory->entries.find(name) : NULL;
+}
+
+bool os::getCachedFileInfo(char *filepath, os::FileInfo *info) {
+    memset(info, 0, sizeof(*info));
+
+    bool neededSyscall = false;
+    CachedEntry *entry = findCachedEntry(filepath, &neededSyscall);
+    if (entry && !entry->hasInfo && !entry->isDirectory) {
+        // Listing didn't give us the metadata (Linux), so fetch it just this once.
+        counters.filesStated++;
+        neededSyscall = true;
+        if (os::getFileInfo(filepath, &entry->modtime, &entry->size)) {
+            entry->hasInfo = true;
+        } else {
+            entry = NULL;
+        }
+    }
+
+    if (neededSyscall) counters.misses++;
+    else counters.hits++;
+
+    if (!entry) return false;
+
+    info->exists = true;
+    info->isDirectory = entry->isDirectory;
+    info->modtime = entry->modtime;
+    info->size = entry->size;
+    return true;
+}
+
+bool os::getCachedFileExists(char *filepath) {
+    bool neededSyscall = false;
+    CachedEntry *entry = findCachedEntry(filepath, &neededSyscall);
+    
+    if (neededSyscall) counters.misses++;
+    else counters.hits++;
+
+    return entry && !entry->isDirectory;
+}
+
+void os::invalidateCachedFileInfo(char *filepath) {
+    char *path = copyNormalizedPath(filepath);
+    defer { delete[] path; };
+    toCacheKey(path);
+
+    char *dir = NULL;
+    splitPath(path, &dir);
+
+    // Relisting the whole directory also catches files that were created or
+    // deleted since it was read.
+    CachedDirectory **existing = cachedDirectories.find(dir);
+    if (!existing) return;
+    
+    CachedDirectory *directory = *existing;
+    directory->entries.release();
+    fillCachedDirectory(directory, dir);
+}
+
+os::StatCacheCounters os::getStatCacheCounters() {
+    return counters;
+}
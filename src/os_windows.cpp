@@ -1,8 +1,13 @@
+#ifdef OS_WINDOWS
+
 #include "os.h"
 #include "dynamic_array.h"
 #include "utils.h"
 
 #include <windows.h>
+#include <psapi.h>
+
+static os::IoCounters ioCounters;
 
 static void toWindowsFilepath(char *filepath, wchar_t *wideFilepath, i32 wideFilepathSize) {
     MultiByteToWideChar(CP_UTF8, 0, filepath, -1, wideFilepath, wideFilepathSize);
@@ -19,29 +24,85 @@ void *os::readEntireFile(char *filepath, i64 *lengthPointer) {
     toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
     
     HANDLE fileHandle = CreateFileW(wideFilepath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (!fileHandle) {
+    if (fileHandle == INVALID_HANDLE_VALUE) {
         if (lengthPointer) *lengthPointer = 0;
         return NULL;
     }
     defer { CloseHandle(fileHandle); };
 
-    i64 length;
-    GetFileSizeEx(fileHandle, (LARGE_INTEGER *)&length);
-    if (lengthPointer) *lengthPointer = length;
+    i64 length = 0;
+    if (!GetFileSizeEx(fileHandle, (LARGE_INTEGER *)&length)) {
+        if (lengthPointer) *lengthPointer = 0;
+        return NULL;
+    }
     
-    void *data = malloc(length + 1);
-    memset(data, 0, length + 1);
+    char *data = (char *)malloc(length + 1);
 
     DWORD bytesRead = 0;
-    ReadFile(fileHandle, data, (DWORD)length, &bytesRead, NULL);
+    if (!ReadFile(fileHandle, data, (DWORD)length, &bytesRead, NULL)) bytesRead = 0;
+    data[bytesRead] = 0;
+    if (lengthPointer) *lengthPointer = bytesRead;
+
+    ioCounters.filesRead++;
+    ioCounters.bytesRead += bytesRead;
     
     return data;
 }
 
+bool os::mapFile(char *filepath, MappedFile *file) {
+    *file = {};
+
+    wchar_t wideFilepath[4096];
+    toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
+
+    HANDLE fileHandle = CreateFileW(wideFilepath, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    defer { CloseHandle(fileHandle); };
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size)) return false;
+    if (size.QuadPart == 0) return true; // Empty files can't be mapped.
+
+    // The view keeps the mapping and the file open on its own.
+    HANDLE mapping = CreateFileMappingW(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return false;
+    defer { CloseHandle(mapping); };
+
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) return false;
+
+    file->data = data;
+    file->length = size.QuadPart;
+
+    ioCounters.filesMapped++;
+    ioCounters.bytesMapped += (u64)size.QuadPart;
+    return true;
+}
+
+void os::unmapFile(MappedFile *file) {
+    if (file->data) UnmapViewOfFile(file->data);
+    *file = {};
+}
+
+bool os::writeEntireFile(char *filepath, void *data, i64 length) {
+    wchar_t wideFilepath[4096];
+    toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
+
+    HANDLE fileHandle = CreateFileW(wideFilepath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    defer { CloseHandle(fileHandle); };
+
+    DWORD bytesWritten = 0;
+    if (!WriteFile(fileHandle, data, (DWORD)length, &bytesWritten, NULL)) return false;
+
+    return bytesWritten == (DWORD)length;
+}
+
 bool os::fileExists(char *filepath) {
     wchar_t wideFilepath[4096];
     toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
 
+    ioCounters.filesStated++;
     DWORD attrib = GetFileAttributesW(wideFilepath);
     return (attrib != INVALID_FILE_ATTRIBUTES &&
             !(attrib & FILE_ATTRIBUTE_DIRECTORY));
@@ -51,11 +112,22 @@ bool os::directoryExists(char *filepath) {
     wchar_t wideFilepath[4096];
     toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
 
+    ioCounters.filesStated++;
     DWORD attrib = GetFileAttributesW(wideFilepath);
     return (attrib != INVALID_FILE_ATTRIBUTES &&
             (attrib & FILE_ATTRIBUTE_DIRECTORY));
 }
 
+char *os::getCurrentDirectory() {
+    wchar_t widePath[4096];
+    DWORD length = GetCurrentDirectoryW(ArrayCount(widePath), widePath);
+    if (!length || length >= ArrayCount(widePath)) return NULL;
+
+    char path[4096 * 3];
+    WideCharToMultiByte(CP_UTF8, 0, widePath, -1, path, sizeof(path), NULL, NULL);
+    return mprintf("%s", path);
+}
+
 static void splitDirectoryIntoSourceDirectories(char *dir, DynamicArray<char *> &dirs) {
     char *at = dir;
     while (true) {
@@ -105,10 +177,50 @@ bool os::makeDirectoryIfNotExist(char *dir) {
     return true;
 }
 
+bool os::listDirectory(char *dir, DynamicArray<os::DirectoryEntry> &entries) {
+    char *pattern = mprintf("%s\\*", dir);
+    defer { free(pattern); };
+    
+    wchar_t widePattern[4096];
+    toWindowsFilepath(pattern, widePattern, ArrayCount(widePattern));
+
+    WIN32_FIND_DATAW findData;
+    HANDLE findHandle = FindFirstFileExW(widePattern, FindExInfoBasic, &findData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (findHandle == INVALID_HANDLE_VALUE) return false;
+    defer { FindClose(findHandle); };
+
+    do {
+        wchar_t *wideName = findData.cFileName;
+        if (wideName[0] == L'.' && (wideName[1] == 0 || (wideName[1] == L'.' && wideName[2] == 0))) continue;
+
+        char name[MAX_PATH * 4];
+        WideCharToMultiByte(CP_UTF8, 0, wideName, -1, name, sizeof(name), NULL, NULL);
+
+        ULARGE_INTEGER modtime;
+        modtime.LowPart = findData.ftLastWriteTime.dwLowDateTime;
+        modtime.HighPart = findData.ftLastWriteTime.dwHighDateTime;
+
+        ULARGE_INTEGER size;
+        size.LowPart = findData.nFileSizeLow;
+        size.HighPart = findData.nFileSizeHigh;
+
+        os::DirectoryEntry entry;
+        entry.name = copyString(name);
+        entry.isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        entry.hasInfo = true;
+        entry.modtime = modtime.QuadPart;
+        entry.size = size.QuadPart;
+        entries.add(entry);
+    } while (FindNextFileW(findHandle, &findData));
+
+    return true;
+}
+
 bool os::getLastWriteTime(char *filepath, u64 *outTime) {
     wchar_t wideFilepath[4096];
     toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
     
+    ioCounters.filesStated++;
     HANDLE file = CreateFileW(wideFilepath, GENERIC_READ,
                               FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
                               OPEN_EXISTING, 0, NULL);
@@ -129,6 +241,28 @@ bool os::getLastWriteTime(char *filepath, u64 *outTime) {
     return true;
 }
 
+bool os::getFileInfo(char *filepath, u64 *outTime, u64 *outSize) {
+    wchar_t wideFilepath[4096];
+    toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
+
+    // Unlike getLastWriteTime this doesn't need to open the file.
+    ioCounters.filesStated++;
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(wideFilepath, GetFileExInfoStandard, &data)) return false;
+
+    ULARGE_INTEGER uli;
+    uli.LowPart = data.ftLastWriteTime.dwLowDateTime;
+    uli.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    if (outTime) *outTime = uli.QuadPart;
+
+    ULARGE_INTEGER size;
+    size.LowPart = data.nFileSizeLow;
+    size.HighPart = data.nFileSizeHigh;
+    if (outSize) *outSize = size.QuadPart;
+
+    return true;
+}
+
 bool os::deleteFile(char *filepath) {
     wchar_t wideFilepath[4096];
     toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
@@ -136,6 +270,15 @@ bool os::deleteFile(char *filepath) {
     return DeleteFileW(wideFilepath);
 }
 
+i64 os::writeStdout(char *data, i64 length, bool wait) {
+    // Console writes return as soon as the text is in the console's buffer,
+    // and there's no way to ask an anonymous pipe how much room it has left,
+    // so this just writes.
+    DWORD written = 0;
+    if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, (DWORD)length, &written, NULL)) return -1;
+    return (i64)written;
+}
+
 double os::getTime() {
     i64 perfCounter;
     QueryPerformanceCounter((LARGE_INTEGER *)&perfCounter);
@@ -146,6 +289,17 @@ double os::getTime() {
     return (double)perfCounter / (double)perfFreq;
 }
 
+os::IoCounters os::getIoCounters() {
+    return ioCounters;
+}
+
+// The K32 version lives in kernel32, so no psapi.lib is needed.
+u64 os::getPeakMemoryUsage() {
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (u64)counters.PeakWorkingSetSize;
+}
+
 bool os::copyFile(char *sourceFile, char *destFile) {
     wchar_t wideSourceFilepath[4096];
     toWindowsFilepath(sourceFile, wideSourceFilepath, ArrayCount(wideSourceFilepath));
@@ -156,3 +310,392 @@ bool os::copyFile(char *sourceFile, char *destFile) {
     BOOL result = CopyFileW(wideSourceFilepath, wideDestFilepath, FALSE);
     return result;
 }
+
+bool os::moveFile(char *sourceFile, char *destFile) {
+    wchar_t wideSourceFilepath[4096];
+    toWindowsFilepath(sourceFile, wideSourceFilepath, ArrayCount(wideSourceFilepath));
+
+    wchar_t wideDestFilepath[4096];
+    toWindowsFilepath(destFile, wideDestFilepath, ArrayCount(wideDestFilepath));
+
+    return MoveFileExW(wideSourceFilepath, wideDestFilepath, MOVEFILE_REPLACE_EXISTING);
+}
+
+bool os::touchFile(char *filepath) {
+    wchar_t wideFilepath[4096];
+    toWindowsFilepath(filepath, wideFilepath, ArrayCount(wideFilepath));
+
+    HANDLE file = CreateFileW(wideFilepath, FILE_WRITE_ATTRIBUTES,
+                              FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    defer { CloseHandle(file); };
+
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return SetFileTime(file, NULL, NULL, &now);
+}
+
+char *os::findExecutable(char *name) {
+    wchar_t wideName[4096];
+    toWindowsFilepath(name, wideName, ArrayCount(wideName));
+
+    wchar_t widePath[4096];
+    DWORD length = SearchPathW(NULL, wideName, L".exe", ArrayCount(widePath), widePath, NULL);
+    if (!length || length >= ArrayCount(widePath)) return NULL;
+
+    char path[4096 * 3];
+    WideCharToMultiByte(CP_UTF8, 0, widePath, -1, path, sizeof(path), NULL, NULL);
+    return mprintf("%s", path);
+}
+
+int os::getProcessorCount() {
+    int count = (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+    // A hard CPU rate cap on the job object we run in limits us the same way a
+    // cgroup quota does on Linux. CpuRate is in 1/100ths of a percent of the
+    // whole machine.
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate = {};
+    if (QueryInformationJobObject(NULL, JobObjectCpuRateControlInformation, &rate, sizeof(rate), NULL)) {
+        if ((rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) &&
+            (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP)) {
+            int limit = (int)(((u64)count * rate.CpuRate + 9999) / 10000);
+            if (limit < count) count = limit;
+        }
+    }
+
+    if (count < 1) count = 1;
+    return count;
+}
+
+bool os::startProcess(char **argv, os::Process *process, bool captureOutput) {
+    process->pidfd = -1;
+    process->outputPipe = -1;
+    process->errorPipe = -1;
+    process->output.count = 0;
+    process->errorOutput.count = 0;
+    process->exitCode = 0;
+    
+    StringBuilder commandLine;
+    for (int i = 0; argv[i]; i++) {
+        if (i) commandLine.add(' ');
+        appendWindowsArgument(&commandLine, argv[i]);
+    }
+    commandLine.add('\0');
+    
+    // CreateProcessW may modify the command line buffer, so it can't be const.
+    i32 wideLength = MultiByteToWideChar(CP_UTF8, 0, commandLine.buffer.data, -1, NULL, 0);
+    wchar_t *wideCommandLine = (wchar_t *)malloc(wideLength * sizeof(wchar_t));
+    defer { free(wideCommandLine); };
+    MultiByteToWideChar(CP_UTF8, 0, commandLine.buffer.data, -1, wideCommandLine, wideLength);
+
+    STARTUPINFOEXW startupInfo = {};
+    startupInfo.StartupInfo.cb = sizeof(startupInfo);
+
+    HANDLE inputHandle = INVALID_HANDLE_VALUE;
+    HANDLE outputRead = INVALID_HANDLE_VALUE, outputWrite = INVALID_HANDLE_VALUE;
+    HANDLE errorRead = INVALID_HANDLE_VALUE, errorWrite = INVALID_HANDLE_VALUE;
+    LPPROC_THREAD_ATTRIBUTE_LIST attributes = NULL;
+    defer {
+        if (inputHandle != INVALID_HANDLE_VALUE) CloseHandle(inputHandle);
+        if (outputWrite != INVALID_HANDLE_VALUE) CloseHandle(outputWrite);
+        if (errorWrite != INVALID_HANDLE_VALUE) CloseHandle(errorWrite);
+        if (attributes) {
+            DeleteProcThreadAttributeList(attributes);
+            free(attributes);
+        }
+    };
+    
+    DWORD flags = 0;
+    if (captureOutput) {
+        SECURITY_ATTRIBUTES security = {};
+        security.nLength = sizeof(security);
+        security.bInheritHandle = TRUE;
+
+        inputHandle = CreateFileW(L"NUL", GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &security, OPEN_EXISTING, 0, NULL);
+        if (inputHandle == INVALID_HANDLE_VALUE) return false;
+        
+        if (!CreatePipe(&outputRead, &outputWrite, &security, 64 * 1024)) return false;
+        if (!CreatePipe(&errorRead, &errorWrite, &security, 64 * 1024)) {
+            CloseHandle(outputRead);
+            return false;
+        }
+        SetHandleInformation(outputRead, HANDLE_FLAG_INHERIT, 0);
+        SetHandleInformation(errorRead, HANDLE_FLAG_INHERIT, 0);
+
+        startupInfo.StartupInfo.dwFlags |= STARTF_USESTDHANDLES;
+        startupInfo.StartupInfo.hStdInput = inputHandle;
+        startupInfo.StartupInfo.hStdOutput = outputWrite;
+        startupInfo.StartupInfo.hStdError = errorWrite;
+
+        // Only these three get inherited, not the pipes of the other
+        // children we have running, or we'd never see those pipes close.
+        HANDLE inherited[3] = { inputHandle, outputWrite, errorWrite };
+        SIZE_T attributesSize = 0;
+        InitializeProcThreadAttributeList(NULL, 1, 0, &attributesSize);
+        attributes = (LPPROC_THREAD_ATTRIBUTE_LIST)malloc(attributesSize);
+        if (!InitializeProcThreadAttributeList(attributes, 1, 0, &attributesSize) ||
+            !UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherited, sizeof(inherited), NULL, NULL)) {
+            free(attributes);
+            attributes = NULL;
+            CloseHandle(outputRead);
+            CloseHandle(errorRead);
+            return false;
+        }
+        startupInfo.lpAttributeList = attributes;
+        flags |= EXTENDED_STARTUPINFO_PRESENT;
+    }
+
+    PROCESS_INFORMATION processInfo = {};
+    if (!CreateProcessW(NULL, wideCommandLine, NULL, NULL, captureOutput ? TRUE : FALSE, flags, NULL, NULL, &startupInfo.StartupInfo, &processInfo)) {
+        if (captureOutput) {
+            CloseHandle(outputRead);
+            CloseHandle(errorRead);
+        }
+        return false;
+    }
+    CloseHandle(processInfo.hThread);
+
+    if (captureOutput) {
+        process->outputPipe = (i64)outputRead;
+        process->errorPipe = (i64)errorRead;
+    }
+    process->handle = (u64)processInfo.hProcess;
+    ioCounters.processesStarted++;
+    return true;
+}
+
+// Reads whatever is in the pipe right now without blocking.
+static void drainPipe(i64 *pipe, DynamicArray<char> &buffer) {
+    while (*pipe != -1) {
+        HANDLE handle = (HANDLE)*pipe;
+        
+        DWORD available = 0;
+        if (!PeekNamedPipe(handle, NULL, 0, NULL, &available, NULL)) {
+            // The child closed its end.
+            CloseHandle(handle);
+            *pipe = -1;
+            return;
+        }
+        if (!available) return;
+
+        buffer.reserve(buffer.count + (int)available);
+        DWORD bytesRead = 0;
+        if (!ReadFile(handle, buffer.data + buffer.count, available, &bytesRead, NULL)) {
+            CloseHandle(handle);
+            *pipe = -1;
+            return;
+        }
+        buffer.count += (int)bytesRead;
+    }
+}
+
+static void finishProcess(os::Process *process) {
+    HANDLE handle = (HANDLE)process->handle;
+
+    DWORD exitCode = 1;
+    GetExitCodeProcess(handle, &exitCode);
+    CloseHandle(handle);
+
+    // The child is gone, so everything it wrote is in the pipes by now. Its
+    // own children (mspdbsrv) may still hold the write ends, so this doesn't
+    // wait for the pipes to close.
+    drainPipe(&process->outputPipe, process->output);
+    drainPipe(&process->errorPipe, process->errorOutput);
+    if (process->outputPipe != -1) CloseHandle((HANDLE)process->outputPipe);
+    if (process->errorPipe != -1) CloseHandle((HANDLE)process->errorPipe);
+    process->outputPipe = -1;
+    process->errorPipe = -1;
+    
+    process->handle = 0;
+    process->exitCode = (int)exitCode;
+}
+
+int os::waitForAnyProcess(os::Process **processes, int count, int timeoutMilliseconds) {
+    if (count <= 0) return -2;
+
+    double deadline = os::getTime() + timeoutMilliseconds / 1000.0;
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    
+    while (true) {
+        bool capturing = false;
+        for (int i = 0; i < count; i++) {
+            drainPipe(&processes[i]->outputPipe, processes[i]->output);
+            drainPipe(&processes[i]->errorPipe, processes[i]->errorOutput);
+            if (processes[i]->outputPipe != -1 || processes[i]->errorPipe != -1) capturing = true;
+        }
+
+        // WaitForMultipleObjects can only wait on 64 handles at once, so the
+        // groups are checked in turn.
+        for (int first = 0; first < count; first += MAXIMUM_WAIT_OBJECTS) {
+            int groupCount = count - first;
+            if (groupCount > MAXIMUM_WAIT_OBJECTS) groupCount = MAXIMUM_WAIT_OBJECTS;
+
+            for (int i = 0; i < groupCount; i++) {
+                handles[i] = (HANDLE)processes[first + i]->handle;
+            }
+
+            DWORD result = WaitForMultipleObjects((DWORD)groupCount, handles, FALSE, 0);
+            if (result == WAIT_FAILED) return -2;
+            if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + (DWORD)groupCount) {
+                int index = first + (int)(result - WAIT_OBJECT_0);
+                finishProcess(processes[index]);
+                return index;
+            }
+        }
+
+        DWORD waitMilliseconds = INFINITE;
+        if (timeoutMilliseconds >= 0) {
+            double remaining = deadline - os::getTime();
+            if (remaining <= 0) return -1;
+            waitMilliseconds = (DWORD)(remaining * 1000.0) + 1;
+        }
+
+        // Pipes can't be waited on together with processes, so while output
+        // is captured (or there are more than 64 processes) we look again
+        // every few milliseconds.
+        if ((capturing || count > MAXIMUM_WAIT_OBJECTS) && waitMilliseconds > 5) {
+            waitMilliseconds = 5;
+        }
+        
+        int groupCount = count < MAXIMUM_WAIT_OBJECTS ? count : MAXIMUM_WAIT_OBJECTS;
+        for (int i = 0; i < groupCount; i++) {
+            handles[i] = (HANDLE)processes[i]->handle;
+        }
+        if (WaitForMultipleObjects((DWORD)groupCount, handles, FALSE, waitMilliseconds) == WAIT_FAILED) {
+            return -2;
+        }
+    }
+}
+
+bool os::killProcess(os::Process *process) {
+    return TerminateProcess((HANDLE)process->handle, 1) != 0;
+}
+
+bool os::setEnvironmentVariable(char *name, char *value) {
+    return SetEnvironmentVariableA(name, value) != 0;
+}
+
+bool os::connectJobserver(char *auth, os::Jobserver *jobserver) {
+    HANDLE semaphore = OpenSemaphoreA(SEMAPHORE_MODIFY_STATE | SYNCHRONIZE, FALSE, auth);
+    if (!semaphore) return false;
+
+    jobserver->readHandle = (i64)semaphore;
+    jobserver->writeHandle = 0;
+    jobserver->auth = copyString(auth);
+    return true;
+}
+
+bool os::createJobserver(int tokenCount, os::Jobserver *jobserver) {
+    // Named the way make names its own, children find it by name.
+    char *name = mprintf("rsc_semaphore_%lu", GetCurrentProcessId());
+    HANDLE semaphore = CreateSemaphoreA(NULL, tokenCount, tokenCount > 0 ? tokenCount : 1, name);
+    if (!semaphore) {
+        free(name);
+        return false;
+    }
+
+    jobserver->readHandle = (i64)semaphore;
+    jobserver->writeHandle = 0;
+    jobserver->auth = name;
+    return true;
+}
+
+bool os::tryAcquireJobToken(os::Jobserver *jobserver, char *token) {
+    *token = '+';
+    return WaitForSingleObject((HANDLE)jobserver->readHandle, 0) == WAIT_OBJECT_0;
+}
+
+void os::releaseJobToken(os::Jobserver *jobserver, char token) {
+    ReleaseSemaphore((HANDLE)jobserver->readHandle, 1, NULL);
+}
+
+struct PendingDirectoryRead {
+    OVERLAPPED overlapped;
+    DWORD buffer[16 * 1024]; // ReadDirectoryChangesW wants it DWORD-aligned.
+};
+
+static bool readDirectoryChanges(os::WatchedDirectory *directory) {
+    PendingDirectoryRead *pending = (PendingDirectoryRead *)directory->pending;
+    pending->overlapped = {};
+    
+    DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_LAST_WRITE|FILE_NOTIFY_CHANGE_SIZE;
+    return ReadDirectoryChangesW((HANDLE)directory->handle, pending->buffer, sizeof(pending->buffer), FALSE,
+                                 filter, NULL, &pending->overlapped, NULL);
+}
+
+bool os::startFileWatcher(os::FileWatcher *watcher) {
+    watcher->directories.count = 0;
+    HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    watcher->handle = (i64)port;
+    return port != NULL;
+}
+
+bool os::watchDirectory(os::FileWatcher *watcher, char *dir) {
+    for (int i = 0; i < watcher->directories.count; i++) {
+        if (stringsMatch(watcher->directories[i].path, dir)) return true;
+    }
+
+    wchar_t wideFilepath[4096];
+    toWindowsFilepath(dir, wideFilepath, ArrayCount(wideFilepath));
+
+    HANDLE handle = CreateFileW(wideFilepath, FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    // The completion key is the directory's index.
+    if (!CreateIoCompletionPort(handle, (HANDLE)watcher->handle, (ULONG_PTR)watcher->directories.count, 0)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    os::WatchedDirectory directory = {};
+    directory.path = copyString(dir);
+    directory.handle = (i64)handle;
+    directory.pending = new PendingDirectoryRead();
+    if (!readDirectoryChanges(&directory)) {
+        CloseHandle(handle);
+        delete (PendingDirectoryRead *)directory.pending;
+        delete[] directory.path;
+        return false;
+    }
+    
+    watcher->directories.add(directory);
+    return true;
+}
+
+bool os::waitForFileChanges(os::FileWatcher *watcher, int timeoutMilliseconds, DynamicArray<char *> &changedPaths) {
+    DWORD timeout = timeoutMilliseconds < 0 ? INFINITE : (DWORD)timeoutMilliseconds;
+    
+    // After the first completion, take whatever else is already there.
+    while (true) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED *overlapped = NULL;
+        BOOL success = GetQueuedCompletionStatus((HANDLE)watcher->handle, &bytes, &key, &overlapped, timeout);
+        if (!overlapped) return GetLastError() == WAIT_TIMEOUT;
+        timeout = 0;
+
+        os::WatchedDirectory *directory = &watcher->directories[(int)key];
+        PendingDirectoryRead *pending = (PendingDirectoryRead *)directory->pending;
+
+        // Zero bytes means the buffer overflowed and the changes are lost.
+        char *at = (char *)pending->buffer;
+        while (success && bytes) {
+            FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)at;
+            
+            char name[4096 * 3];
+            int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, (int)(info->FileNameLength / sizeof(wchar_t)),
+                                             name, sizeof(name) - 1, NULL, NULL);
+            name[length] = 0;
+            changedPaths.add(mprintf("%s/%s", directory->path, name));
+
+            if (!info->NextEntryOffset) break;
+            at += info->NextEntryOffset;
+        }
+
+        if (!readDirectoryChanges(directory)) return false;
+    }
+}
+
+#endif
@@ -115,8 +115,10 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
                 kind = OutputKind_ConsoleApp;
             } else if (token.equals("WindowedApp")) {
                 kind = OutputKind_WindowedApp;
+            } else if (token.equals("StaticLib")) {
+                kind = OutputKind_StaticLib;
             } else {
-                tokenizer->reportError("Invalid project kind '%s', valid values are:\n    ConsoleApp\n    WindowedApp");
+                tokenizer->reportError("Invalid project kind '%.*s', valid values are:\n    ConsoleApp\n    WindowedApp\n    StaticLib", token.textLength, token.text);
                 return false;
             }
 
@@ -266,6 +268,60 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
             }
 
             if (!tokenizer->expectToken(&token, TokenType_Semicolon)) return false;
+        } else if (token.equals("unityBuild")) {
+            if (!tokenizer->expectToken(&token, TokenType_Equals)) return false;
+            if (!tokenizer->expectToken(&token, TokenType_Identifier)) return false;
+
+            bool value = false;
+            if (token.equals("true")) {
+                value = true;
+            } else if (token.equals("false")) {
+                value = false;
+            } else {
+                tokenizer->reportError("Invalid boolean value '%s', valid values are:\n    true\n    false");
+                return false;
+            }
+            
+            if (currentConfiguration) {
+                currentConfiguration->unityBuild = value;
+                currentConfiguration->unityBuildSet = true;
+            } else {
+                project->unityBuild = value;
+                project->unityBuildSet = true;
+            }
+
+            if (!tokenizer->expectToken(&token, TokenType_Semicolon)) return false;
+        } else if (token.equals("unityBatchSize")) {
+            if (!tokenizer->expectToken(&token, TokenType_Equals)) return false;
+            if (!tokenizer->expectToken(&token, TokenType_Number)) return false;
+
+            char *number = toCString(token);
+            int value = atoi(number);
+            free(number);
+            if (value < 1) {
+                tokenizer->reportError("unityBatchSize has to be at least 1");
+                return false;
+            }
+            
+            if (currentConfiguration) {
+                currentConfiguration->unityBatchSize = value;
+                currentConfiguration->unityBatchSizeSet = true;
+            } else {
+                project->unityBatchSize = value;
+                project->unityBatchSizeSet = true;
+            }
+
+            if (!tokenizer->expectToken(&token, TokenType_Semicolon)) return false;
+        } else if (token.equals("unityExclude")) {
+            if (currentConfiguration) {
+                if (!parseStringArray(tokenizer, currentConfiguration->unityExclude)) {
+                    return false;
+                }
+            } else {
+                if (!parseStringArray(tokenizer, project->unityExclude)) {
+                    return false;
+                }
+            }
         } else if (token.equals("runtime")) {
             if (!tokenizer->expectToken(&token, TokenType_Equals)) return false;
             if (!tokenizer->expectToken(&token, TokenType_Identifier)) return false;
@@ -283,6 +339,26 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
             if (currentConfiguration) currentConfiguration->runtimeType = value;
             else project->runtimeType = value;
 
+            if (!tokenizer->expectToken(&token, TokenType_Semicolon)) return false;
+        } else if (token.equals("toolchain")) {
+            if (!tokenizer->expectToken(&token, TokenType_Equals)) return false;
+            if (!tokenizer->expectToken(&token, TokenType_Identifier)) return false;
+
+            ToolchainType value = ToolchainType_Auto;
+            if (token.equals("msvc")) {
+                value = ToolchainType_MSVC;
+            } else if (token.equals("gcc")) {
+                value = ToolchainType_GCC;
+            } else if (token.equals("clang")) {
+                value = ToolchainType_Clang;
+            } else {
+                tokenizer->reportError("Invalid toolchain '%.*s', valid values are:\n    msvc\n    gcc\n    clang", token.textLength, token.text);
+                return false;
+            }
+
+            if (currentConfiguration) currentConfiguration->toolchain = value;
+            else project->toolchain = value;
+
             if (!tokenizer->expectToken(&token, TokenType_Semicolon)) return false;
         } else if (token.equals("defines")) {
             if (currentConfiguration) {
@@ -304,6 +380,16 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
                     return false;
                 }
             }
+        } else if (token.equals("externalIncludeDirs")) {
+            if (currentConfiguration) {
+                if (!parseStringArray(tokenizer, currentConfiguration->externalIncludeDirs)) {
+                    return false;
+                }
+            } else {
+                if (!parseStringArray(tokenizer, project->externalIncludeDirs)) {
+                    return false;
+                }
+            }
         } else if (token.equals("libDirs")) {
             if (currentConfiguration) {
                 if (!parseStringArray(tokenizer, currentConfiguration->libDirs)) {
@@ -324,6 +410,16 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
                     return false;
                 }
             }
+        } else if (token.equals("dependsOn")) {
+            if (currentConfiguration) {
+                if (!parseStringArray(tokenizer, currentConfiguration->dependsOn)) {
+                    return false;
+                }
+            } else {
+                if (!parseStringArray(tokenizer, project->dependsOn)) {
+                    return false;
+                }
+            }
         } else if (token.equals("pchheader")) {
             if (!tokenizer->expectToken(&token, TokenType_Equals)) return false;
             if (!tokenizer->expectToken(&token, TokenType_String)) return false;
@@ -354,8 +450,8 @@ static bool parseProject(Tokenizer *tokenizer, RscProject *project) {
     return true;
 }
 
-bool parseRscFile(char *filepath, char *data) {
-    Tokenizer tokenizer(filepath, data);
+bool parseRscFile(char *filepath, char *data, i64 length) {
+    Tokenizer tokenizer(filepath, data, length);
     
     Token token;
     if (!tokenizer.expectToken(&token, "version")) return false;
@@ -1,6 +1,16 @@
 #include "main.h"
 #include "utils.h"
 #include "os.h"
+#include "jobs.h"
+#include "unity.h"
+#include "dependency_db.h"
+#include "include_graph.h"
+#include "compile_cache.h"
+#include "console.h"
+#include "toolchain.h"
+#include "trace.h"
+#include "stats.h"
+#include "header_report.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -91,82 +101,547 @@ static char *doMacroSubstitutions(char *s, RscProject *project, RscConfiguration
     return sanitized.toString();
 }
 
-static char *getDirectoryFromFilename(char *string) {
-    if (!string) return NULL;
+// Part of every object's input signature in --content-hash mode, since the
+// .rsc file decides how everything gets compiled. Computed once per build.
+static bool rscContentHashComputed = false;
+static Hash128 rscContentHash = {};
 
-    char *result = copyString(string);
+static Hash128 getRscContentHash() {
+    if (!rscContentHashComputed) {
+        rscContentHash = {};
+        os::MappedFile file;
+        if (os::mapFile(globalData.filename, &file)) {
+            rscContentHash = hashContents(file.data, file.length);
+            os::unmapFile(&file);
+        }
+        rscContentHashComputed = true;
+    }
+    
+    return rscContentHash;
+}
+
+static Hash128 getObjectSignature(Hash128 depsSignature, Hash128 pchSignature) {
+    HashBuilder builder;
+    builder.add(getRscContentHash());
+    builder.add(depsSignature);
+    builder.add(pchSignature);
+    return builder.state;
+}
+
+// Command lines longer than this get their arguments moved into a response
+// file. CreateProcess takes at most 32767 characters, and the compiler line
+// still gets a source path appended for every file.
+#define RESPONSE_FILE_THRESHOLD 8000
+
+// Once line is long, replaces its arguments from firstArg on with @path and
+// writes them to path, one per line. A file that already has the same
+// contents is left untouched, so it gets reused from the last run. Returns
+// the contents, or NULL if the line was short enough to leave alone.
+static char *moveToResponseFile(Toolchain *toolchain, CommandLine *line, int firstArg, char *path) {
+    i64 length = 0;
+    for (int i = 0; i < line->args.count; i++) {
+        length += getStringLength(line->args[i]) + 1;
+    }
+    if (length <= RESPONSE_FILE_THRESHOLD) return NULL;
+
+    StringBuilder builder;
+    for (int i = firstArg; i < line->args.count; i++) {
+        toolchain->appendResponseFileArgument(&builder, line->args[i]);
+        builder.add('\n');
+    }
+    
+    if (!writeFileIfChanged(path, builder.buffer.data, builder.buffer.count)) {
+        fprintf(stderr, "Failed to write response file '%s'\n", path);
+        exit(1);
+    }
+
+    line->args.count = firstArg;
+    toolchain->addPath(line, "@", path);
+    return builder.toString();
+}
+
+static char *getObjectPath(Toolchain *toolchain, char *objdir, char *filename) {
+    char *dirWithName = copyStripExtension(filename);
+    dirWithName = replaceBackslashWithForwardslash(dirWithName);
+    char *slash = strrchr(dirWithName, '/');
+    char *name = slash ? slash + 1 : dirWithName;
     
-    char *slash = strrchr(result, '/');
-    result[slash - result] = 0;
+    char *result = mprintf("%s\\%s.%s", objdir, name, toolchain->objectExtension);
+    delete[] dirWithName;
     return result;
 }
 
-static void checkFileForIncludes(char *filename, DynamicArray<char *> &includes) {
-    char *data = (char *)os::readEntireFile(filename);
-    if (!data) return;
-    defer { delete [] data; };
+// Headers under the compiler's own INCLUDE directories count as immutable,
+// just like externalIncludeDirs.
+static bool isSystemHeader(char *path) {
+    static bool initialized = false;
+    static DynamicArray<char *> systemDirs;
+    
+    if (!initialized) {
+        initialized = true;
 
-    char *at = data;
-    while (1) {
-        char *line = consumeNextLine(&at);
-        if (!line) break;
+        char *include = getenv("INCLUDE");
+        if (include) {
+            char *dirs = copyString(include); // @Leak
+            for (char *dir = strtok(dirs, ";"); dir; dir = strtok(NULL, ";")) {
+                if (!dir[0]) continue;
+#ifdef OS_WINDOWS
+                dir = copyStringLowercased(dir); // @Leak
+#endif
+                systemDirs.add(mprintf("%s/", copyNormalizedPath(dir))); // @Leak
+            }
+        }
+    }
 
-        line = eatWhitespace(line);
+    if (!systemDirs.count) return false;
+    
+#ifdef OS_WINDOWS
+    path = copyStringLowercased(path);
+    defer { delete[] path; };
+#endif
+    for (int i = 0; i < systemDirs.count; i++) {
+        if (startsWith(path, systemDirs[i])) return true;
+    }
+    return false;
+}
 
-        if (!startsWith(line, "#include")) continue;
-            
-        line += getStringLength("#include");
-        line = eatWhitespace(line);
+static void addDependency(DynamicArray<char *> &deps, StringTable<bool> &seen, char *path) {
+    char *normalized = copyNormalizedPath(path);
+    bool added = false;
+    if (!isSystemHeader(normalized)) {
+        seen.add(normalized, &added);
+    }
+    if (added) {
+        deps.add(normalized);
+    } else {
+        delete[] normalized;
+    }
+}
 
-        if (line[0] != '"' && line[0] != '<') {
-            //fprintf(stderr, "Shit happened\n");
-            continue;
+// cl writes every header it opens to stdout with /showIncludes, gcc and
+// clang write them to a depfile with -MMD. They are stored in the database
+// as the dependency list of the object, next to the object's modtime and
+// size so the list is only ever trusted for exactly the object it came from.
+// The /showIncludes lines are taken out of the job's output, everything else
+// the compiler said is left in to be printed.
+static void processCompilerOutput(Toolchain *toolchain, DepDatabase *db, Job *job, char *sourcePath, char *objectPath) {
+    DynamicArray<char *> deps;
+    StringTable<bool> seen;
+    deps.add(copyNormalizedPath(sourcePath));
+    seen.add(deps[0]);
+
+    // Without a depfile there's no list, and the include graph has to decide next time.
+    bool complete = true;
+    if (!toolchain->reportsIncludesInOutput && job->finished && job->exitCode == 0) {
+        char *depfilePath = toolchain->getDepfilePath(objectPath);
+        defer { free(depfilePath); };
+
+        DynamicArray<char *> paths;
+        complete = readDepfile(depfilePath, paths);
+        for (int i = 0; i < paths.count; i++) {
+            addDependency(deps, seen, paths[i]);
+            free(paths[i]);
         }
+    }
 
-        line++;
+    DynamicArray<char> &output = job->process.output;
+    output.reserve(output.count + 1); // Room to terminate a last line without a newline.
+    char *kept = output.data;
+
+    char *notePrefix = "Note: including file:";
+    i64 notePrefixLength = getStringLength(notePrefix);
+    
+    char *at = output.data;
+    char *end = output.data + output.count;
+    while (at < end) {
+        char *lineEnd = (char *)memchr(at, '\n', end - at);
+        if (!lineEnd) lineEnd = end;
+        char *next = lineEnd < end ? lineEnd + 1 : end;
         
-        DynamicArray<char> includeNameString;
-        while (1) {
-            if (line[0] == 0) {
-                fprintf(stderr, "EOF found while parsing string in c file.");
-                continue;
-            }
-            if (line[0] == '>' || line[0] == '"') break;
+        if (toolchain->reportsIncludesInOutput && lineEnd - at >= notePrefixLength && memcmp(at, notePrefix, notePrefixLength) == 0) {
+            char *path = at + notePrefixLength;
+            while (path < lineEnd && *path == ' ') path++;
+            char *pathEnd = lineEnd;
+            while (pathEnd > path && (pathEnd[-1] == '\r' || pathEnd[-1] == ' ')) pathEnd--;
+            *pathEnd = 0;
 
-            includeNameString.add(line[0]);
-            line++;
+            if (path[0]) {
+                addDependency(deps, seen, path);
+            }
+        } else {
+            memmove(kept, at, next - at);
+            kept += next - at;
+        }
+        
+        at = next;
+    }
+    output.count = (int)(kept - output.data);
+    
+    if (complete && job->finished && job->exitCode == 0) {
+        u64 objectModtime = 0;
+        u64 objectSize = 0;
+        if (os::getFileInfo(objectPath, &objectModtime, &objectSize)) {
+            db->record(objectPath, objectModtime, objectSize, deps);
         }
-        includeNameString.add(0);
+    }
+
+    for (int i = 0; i < deps.count; i++) {
+        delete[] deps[i];
+    }
+}
+
+// Answers whether an object built at builtAt is out of date from the
+// dependency list the compiler reported when it compiled objectPath. Returns false
+// when there is no trustworthy list, then the include graph has to decide.
+static bool checkCompilerDeps(IncludeGraph *graph, DepDatabase *db, char *objectPath, u64 objectModtime, u64 objectSize, u64 builtAt, bool *stale) {
+    int index = db->find(objectPath);
+    if (index < 0) return false;
 
-        char *fileNameDirectory = getDirectoryFromFilename(filename);
+    DepRecord record = db->records[index];
+    if (!record.includeCount || record.modtime != objectModtime || record.size != objectSize) return false;
+
+    *stale = false;
+    for (u32 i = 0; i < record.includeCount; i++) {
+        char *dep = db->getInclude(index, i);
         
-        DynamicArray<char *> directories;
-        directories.add(fileNameDirectory);
+        // External headers don't change, they only have to still be there.
+        if (graph->isImmutablePath(dep)) {
+            if (os::getCachedFileExists(dep)) continue;
+            *stale = true;
+            break;
+        }
         
-        bool fileExists = false;
-        char *fullPath = NULL;
-        for (int i = 0; i < directories.count; i++) {
-            char *dir = directories[i];
-            if (!dir) {
-                fileExists = os::fileExists(filename);
-                continue;
-            }
-
-            char *path = mprintf("%s/%s", dir, includeNameString.data);
-            fileExists = os::fileExists(path);
-            if (fileExists) {
-                fullPath = path;
-            }
+        os::FileInfo info;
+        os::getCachedFileInfo(dep, &info);
+        if (!info.exists || info.modtime > builtAt) {
+            *stale = true;
+            break;
         }
+    }
+    return true;
+}
+
+static void addUnique(DynamicArray<char *> &array, char *s) {
+    for (int i = 0; i < array.count; i++) {
+        if (stringsMatch(array[i], s)) return;
+    }
+    array.add(s);
+}
+
+static void addUnique(DynamicArray<Job *> &array, Job *job) {
+    for (int i = 0; i < array.count; i++) {
+        if (array[i] == job) return;
+    }
+    array.add(job);
+}
+
+// A precompiled header built by one project and used by every later one
+// whose flags would make it come out the same.
+struct SharedPch {
+    Hash128 key;
+    char *pchPath;
+    char *objectPath;
+    u64 objectModtime;
+    bool stale;
+    Job *job; // NULL when it's up to date.
+    DepDatabase *depDatabase; // Of the project that builds it.
+
+    // See getBuiltPchSignature.
+    bool signatureComputed;
+    bool hasSignature;
+    Hash128 signature;
+};
+
+// Everything the jobs of one project need to know once they run.
+struct ProjectBuild {
+    RscProject *project = NULL;
+    Toolchain *toolchain = NULL;
+    
+    char *exepath = NULL; // The executable or static library the project produces.
+    u64 exeModtime = 0;
+    bool needsLink = false;
+
+    DepDatabase *depDatabase = NULL;
+    IncludeGraph *includeGraph = NULL;
+    SharedPch *pch = NULL;
+
+    // Static libraries of the projects this one depends on, directly or not.
+    DynamicArray<char *> dependencyLibs;
+
+    // The final jobs of the projects this one depends on, directly or not.
+    // Only our link waits for them, so our compiles overlap with theirs.
+    DynamicArray<Job *> dependencyJobs;
+    Job *doneJob = NULL;
+};
+
+struct CompileAction {
+    ProjectBuild *build;
+    char *sourcePath;
+    char *objectPath;
+    bool precompiledHeader;
+    Hash128 directKey; // Zero when the compile cache is disabled.
+    Hash128 pchFlagsHash; // Remembered for the precompiled header, a change rebuilds it.
+};
+
+struct ResourceAction {
+    ProjectBuild *build;
+    char *resourceFile;
+    char *outputPath;
+};
+
+// The dependency list the compiler reported for the object that is there now.
+static bool getRecordedDeps(DepDatabase *db, char *objectPath, DynamicArray<char *> &deps) {
+    int index = db->find(objectPath);
+    if (index < 0) return false;
+
+    u64 objectModtime = 0;
+    u64 objectSize = 0;
+    if (!os::getFileInfo(objectPath, &objectModtime, &objectSize)) return false;
+    
+    DepRecord record = db->records[index];
+    if (!record.includeCount || record.modtime != objectModtime || record.size != objectSize) return false;
+
+    for (u32 i = 0; i < record.includeCount; i++) {
+        deps.add(db->getInclude(index, i));
+    }
+    return true;
+}
+
+// Combined content hash of what the compiler reported objectPath was
+// compiled from, with the contents those files have now.
+static bool getRecordedSignature(IncludeGraph *graph, DepDatabase *db, char *objectPath, Hash128 *signature) {
+    DynamicArray<char *> deps;
+    return getRecordedDeps(db, objectPath, deps) && graph->getInputSignature(deps, db, signature);
+}
 
-        if (fileExists) {
-            includes.add(fullPath);
-            checkFileForIncludes(fullPath, includes);
+// With gcc and clang the header reaches every file through -include rather
+// than an #include the compiler reports for the file, so what the
+// precompiled header was built from is part of every file's signature.
+// The files are only compiled once it's built, and from then on it's fixed.
+static bool getBuiltPchSignature(ProjectBuild *build, Hash128 *signature) {
+    SharedPch *pch = build->pch;
+    *signature = {};
+    if (!pch) return true;
+
+    if (!pch->signatureComputed) {
+        pch->hasSignature = getRecordedSignature(build->includeGraph, pch->depDatabase, pch->objectPath, &pch->signature);
+        pch->signatureComputed = true;
+    }
+    *signature = pch->signature;
+    return pch->hasSignature;
+}
+
+static Hash128 getCacheKey(Hash128 directKey, Hash128 depsSignature, Hash128 pchSignature) {
+    HashBuilder builder;
+    builder.add(directKey);
+    builder.add(depsSignature);
+    builder.add(pchSignature);
+    return builder.state;
+}
+
+// The headers of the last compile stored under the same direct key are
+// probably the ones this compile reads as well. If all of them still have
+// the contents they had then, so does the object.
+static bool restoreFromCompileCache(ProjectBuild *build, CompileAction *action) {
+    DynamicArray<char *> deps;
+    defer {
+        for (int i = 0; i < deps.count; i++) delete[] deps[i];
+    };
+
+    Hash128 depsSignature = {};
+    Hash128 pchSignature = {};
+    if (!getBuiltPchSignature(build, &pchSignature) ||
+        !compileCache.loadManifest(action->directKey, deps) ||
+        !build->includeGraph->getInputSignature(deps, build->depDatabase, &depsSignature)) {
+        compileCache.misses++;
+        return false;
+    }
+
+    Hash128 key = getCacheKey(action->directKey, depsSignature, pchSignature);
+    if (!compileCache.restore(key, action->objectPath, build->toolchain->objectExtension)) return false;
+
+    // As if the compiler had reported them, so the next build can go by them too.
+    u64 objectModtime = 0;
+    u64 objectSize = 0;
+    if (os::getFileInfo(action->objectPath, &objectModtime, &objectSize)) {
+        build->depDatabase->record(action->objectPath, objectModtime, objectSize, deps);
+        if (globalData.contentHash) {
+            build->depDatabase->setContentHash(action->objectPath, getObjectSignature(depsSignature, pchSignature));
         }
     }
+    return true;
 }
 
-void executeMSVCForProject(RscProject *project, RscConfiguration *configuration, u64 rscModtime) {
+static void storeInCompileCache(ProjectBuild *build, CompileAction *action) {
+    DynamicArray<char *> deps;
+    Hash128 depsSignature = {};
+    Hash128 pchSignature = {};
+    if (!getRecordedDeps(build->depDatabase, action->objectPath, deps) ||
+        !build->includeGraph->getInputSignature(deps, build->depDatabase, &depsSignature) ||
+        !getBuiltPchSignature(build, &pchSignature)) {
+        return;
+    }
+
+    Hash128 key = getCacheKey(action->directKey, depsSignature, pchSignature);
+    compileCache.store(key, action->objectPath, build->toolchain->objectExtension);
+    compileCache.storeManifest(action->directKey, action->objectPath, deps);
+}
+
+// The precompiled header the job depends on is built by now, so the key
+// can't be made any earlier than right before the compiler would start.
+static bool prepareCompile(Job *job) {
+    CompileAction *action = (CompileAction *)job->userData;
+    if (isZero(action->directKey)) return true;
+
+    double lookupStartTime = os::getTime();
+    defer {
+        trace.addSpan(lookupStartTime, os::getTime(), 0, "cache", "Cache lookup %s", action->sourcePath);
+        stats.addPhaseTime("cacheLookup", lookupStartTime, os::getTime());
+    };
+
+    return !restoreFromCompileCache(action->build, action);
+}
+
+static void finishCompile(Job *job) {
+    CompileAction *action = (CompileAction *)job->userData;
+    ProjectBuild *build = action->build;
+
+    if (!build->toolchain->echoesSourceName) {
+        // Like cl does, so there's something to see for every file.
+        char *slash = strrchr(action->sourcePath, '\\');
+        if (!slash) slash = strrchr(action->sourcePath, '/');
+        console.printf("%s\n", slash ? slash + 1 : action->sourcePath);
+    }
+
+    processCompilerOutput(build->toolchain, build->depDatabase, job, action->sourcePath, action->objectPath);
+    if (job->exitCode != 0) {
+        // Don't leave an output behind that looks newer than the objects that failed.
+        os::deleteFile(build->exepath);
+        return;
+    }
+    if (action->precompiledHeader) {
+        build->depDatabase->setContentHash(action->objectPath, action->pchFlagsHash);
+        return;
+    }
+    
+    if (!isZero(action->directKey)) {
+        storeInCompileCache(build, action);
+    }
+    Hash128 depsSignature = {};
+    Hash128 pchSignature = {};
+    if (globalData.contentHash && getRecordedSignature(build->includeGraph, build->depDatabase, action->objectPath, &depsSignature) &&
+        getBuiltPchSignature(build, &pchSignature)) {
+        build->depDatabase->setContentHash(action->objectPath, getObjectSignature(depsSignature, pchSignature));
+    }
+}
+
+// Whether a static library we link against got rebuilt is only known once
+// its project is done, so this is decided when the link is about to start.
+static bool isLinkNeeded(ProjectBuild *build) {
+    if (build->needsLink) return true;
+    if (build->project->kind == OutputKind_StaticLib) return false;
+
+    for (int i = 0; i < build->dependencyLibs.count; i++) {
+        u64 libModtime = 0;
+        os::getLastWriteTime(build->dependencyLibs[i], &libModtime);
+        if (libModtime > build->exeModtime) return true;
+    }
+    return false;
+}
+
+static bool prepareResource(Job *job) {
+    ResourceAction *action = (ResourceAction *)job->userData;
+    if (!isLinkNeeded(action->build)) return false;
+
+    if (globalData.verbose) {
+        console.printf("Resource-Compiler line: %s\n", job->commandLine->toString()); // @Leak
+    } else {
+        console.printf("Compiling %s\n", action->resourceFile);
+    }
+    return true;
+}
+
+static void finishResource(Job *job) {
+    if (job->exitCode != 0) return;
+    
+    ResourceAction *action = (ResourceAction *)job->userData;
+    
+    char *filepathWithoutExtension = copyString(action->resourceFile);
+    char *t = strrchr(filepathWithoutExtension, '.');
+    if (t) {
+        filepathWithoutExtension[t - filepathWithoutExtension] = 0;
+    }
+        
+    char *srcFilepath = mprintf("%s.res", filepathWithoutExtension);
+    bool success = os::copyFile(srcFilepath, action->outputPath);
+    if (!success) {
+        console.printf("Failed to copy '%s' to '%s'\n", srcFilepath, action->outputPath);
+        job->exitCode = 1;
+    }
+}
+
+static bool prepareLink(Job *job) {
+    ProjectBuild *build = (ProjectBuild *)job->userData;
+    if (!isLinkNeeded(build)) return false;
+
+    if (globalData.verbose) {
+        console.printf("Linker line: %s\n", job->commandLine->toString()); // @Leak
+    } else {
+        console.printf("%s %s\n", build->project->kind == OutputKind_StaticLib ? "Archiving" : "Linking", build->exepath);
+    }
+
+    // ar adds to an existing archive, objects of files that are gone would stay in it.
+    if (build->project->kind == OutputKind_StaticLib) {
+        os::deleteFile(build->exepath);
+    }
+    return true;
+}
+
+static void finishLink(Job *job) {
+    ProjectBuild *build = (ProjectBuild *)job->userData;
+    if (job->exitCode != 0) {
+        os::deleteFile(build->exepath);
+    }
+}
+
+static void getIncludeDirs(RscProject *project, RscConfiguration *configuration,
+                           DynamicArray<char *> &includeDirs, DynamicArray<char *> &externalIncludeDirs) {
+    for (int i = 0; i < project->includeDirs.count; i++) {
+        char *dir = project->includeDirs[i];
+        includeDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
+    }
+    for (int i = 0; i < configuration->includeDirs.count; i++) {
+        char *dir = configuration->includeDirs[i];
+        includeDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
+    }
+
+    for (int i = 0; i < project->externalIncludeDirs.count; i++) {
+        char *dir = project->externalIncludeDirs[i];
+        externalIncludeDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
+    }
+    for (int i = 0; i < configuration->externalIncludeDirs.count; i++) {
+        char *dir = configuration->externalIncludeDirs[i];
+        externalIncludeDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
+    }
+}
+
+static DynamicArray<SharedPch *> sharedPchs;
+static int pchBuildsAvoided = 0;
+
+// Of the last executeProjects, for --watch.
+static DynamicArray<DepDatabase *> lastDepDatabases;
+
+static SharedPch *findSharedPch(Hash128 key) {
+    for (int i = 0; i < sharedPchs.count; i++) {
+        if (hashesMatch(sharedPchs[i]->key, key)) return sharedPchs[i];
+    }
+    return NULL;
+}
+
+// Works out what is out of date in one project and adds the jobs that bring
+// it up to date to the scheduler. Nothing runs yet.
+static ProjectBuild *planProject(RscProject *project, RscConfiguration *configuration, u64 rscModtime,
+                                 DynamicArray<ProjectBuild *> &dependencies, JobScheduler *scheduler) {
     char *outputdir = mprintf("build\\%s", configuration->name);
     if (project->outputdir) outputdir = project->outputdir;
     if (configuration->outputdir) outputdir = configuration->outputdir;
@@ -185,10 +660,36 @@ void executeMSVCForProject(RscProject *project, RscConfiguration *configuration,
     replaceForwardslashWithBackslash(outputname);
     outputname = doMacroSubstitutions(outputname, project, configuration); // @Leak
     
+    ToolchainType toolchainType = project->toolchain;
+    if (configuration->toolchain != ToolchainType_Auto) toolchainType = configuration->toolchain;
+    Toolchain *toolchain = getToolchain(toolchainType);
+    
     u64 exeModtime = 0;
-    char *exepath = mprintf("%s/%s.exe", outputdir, outputname);
+    char *exepath = toolchain->getOutputPath(project->kind, outputdir, outputname);
     os::getLastWriteTime(exepath, &exeModtime);
 
+    ProjectBuild *build = new ProjectBuild(); // @Leak
+    build->project = project;
+    build->toolchain = toolchain;
+    build->exepath = exepath;
+    build->exeModtime = exeModtime;
+
+    for (int i = 0; i < dependencies.count; i++) {
+        ProjectBuild *dependency = dependencies[i];
+
+        addUnique(build->dependencyJobs, dependency->doneJob);
+        for (int j = 0; j < dependency->dependencyJobs.count; j++) {
+            addUnique(build->dependencyJobs, dependency->dependencyJobs[j]);
+        }
+
+        if (dependency->project->kind == OutputKind_StaticLib) {
+            addUnique(build->dependencyLibs, dependency->exepath);
+        }
+        for (int j = 0; j < dependency->dependencyLibs.count; j++) {
+            addUnique(build->dependencyLibs, dependency->dependencyLibs[j]);
+        }
+    }
+
     char *pchheader = project->pchheader;
     if (configuration->pchheader) pchheader = configuration->pchheader;
     pchheader = replaceForwardslashWithBackslash(pchheader);
@@ -196,78 +697,64 @@ void executeMSVCForProject(RscProject *project, RscConfiguration *configuration,
     char *pchsource = project->pchsource;
     if (configuration->pchsource) pchsource = configuration->pchsource;
     pchsource = replaceForwardslashWithBackslash(pchsource);
-    
-    if (rscModtime > exeModtime) {
-        globalData.rebuild = true;
-    }
 
     os::makeDirectoryIfNotExist(outputdir);
     os::makeDirectoryIfNotExist(objdir);
-    
-    DynamicArray<char *> filesToCompile;
-    for (int i = 0; i < project->files.count; i++) {
-        char *filename = project->files[i];
-
-        if (globalData.rebuild) {
-            filesToCompile.add(filename);
-            continue;
-        }
-        
-        DynamicArray<char *> fileIncludes;
-        checkFileForIncludes(filename, fileIncludes);
 
-        u64 latestModtime = 0;
-        os::getLastWriteTime(filename, &latestModtime);
+    bool unityBuild = project->unityBuild;
+    if (configuration->unityBuildSet) unityBuild = configuration->unityBuild;
+    int unityBatchSize = project->unityBatchSize;
+    if (configuration->unityBatchSizeSet) unityBatchSize = configuration->unityBatchSize;
 
-        for (int i = 0; i < fileIncludes.count; i++) {
-            char *includename = fileIncludes[i];
-            u64 includeModtime = 0;
-            os::getLastWriteTime(includename, &includeModtime);
-
-            if (includeModtime > latestModtime) {
-                latestModtime = includeModtime;
-            }
+    // The translation units actually compiled, which for a unity build are
+    // mostly generated batch files.
+    DynamicArray<char *> files;
+    if (unityBuild) {
+        DynamicArray<char *> unityExclude;
+        for (int i = 0; i < project->unityExclude.count; i++) {
+            unityExclude.add(project->unityExclude[i]);
         }
-
-        if (latestModtime > exeModtime) {
-            filesToCompile.add(filename);
+        for (int i = 0; i < configuration->unityExclude.count; i++) {
+            unityExclude.add(configuration->unityExclude[i]);
         }
-    }
-
-    if (!filesToCompile.count) return;
-    
-    StringBuilder compilerLine;
-    compilerLine.add("cl /c /nologo /W3 /diagnostics:column /WL /FC /Oi /EHsc /Zc:strictStrings- /std:c++20 /Zc:strictStrings- /D_CRT_SECURE_NO_WARNINGS ");
-
-    bool debugSymbols = project->debugSymbols;
-    if (configuration->debugSymbolsSet) debugSymbols = configuration->debugSymbols;
-    bool optimize = project->optimize;
-    if (configuration->optimizeSet) optimize = configuration->optimize;
-    bool staticRuntime = project->staticRuntime;
-    if (configuration->staticRuntimeSet) staticRuntime = configuration->staticRuntime;
-
-    RuntimeType runtimeType = project->runtimeType;
-    if (staticRuntime) {
-        compilerLine.add("/MT");
+        
+        // Only cl needs the batches to start with the precompiled header,
+        // the others include it through the command line.
+        char *unityPchheader = toolchain->type == ToolchainType_MSVC ? pchheader : NULL;
+        planUnityBuild(project->files, unityExclude, unityBatchSize, objdir, toolchain->objectExtension,
+                       unityPchheader, globalData.rebuild, files);
     } else {
-        compilerLine.add("/MD");
+        for (int i = 0; i < project->files.count; i++) {
+            files.add(project->files[i]);
+        }
     }
 
-    if (runtimeType == RuntimeType_Debug) {
-        compilerLine.add('d');
-    }
+    BuildSettings settings;
+    settings.kind = project->kind;
+    settings.objdir = objdir;
+    settings.outputdir = outputdir;
 
-    compilerLine.add(' ');
+    DynamicArray<char *> &includeDirs = settings.includeDirs;
+    DynamicArray<char *> &externalIncludeDirs = settings.externalIncludeDirs;
+    getIncludeDirs(project, configuration, includeDirs, externalIncludeDirs);
+    
+    IncludeGraph *includeGraph = getIncludeGraph(includeDirs, externalIncludeDirs);
+    
+    // The include graph outlives this function and remembers which database
+    // each node was recorded in, so the database has to stay alive too.
+    DepDatabase *depDatabase = new DepDatabase(); // @Leak
+    depDatabase->load(mprintf("%s\\rsc.deps", objdir)); // @Leak
+    build->depDatabase = depDatabase;
+    build->includeGraph = includeGraph;
 
-    if (optimize) {
-        compilerLine.add("/O2 /Ob2 ");
-    } else {
-        compilerLine.add("/Od /Ob0 ");
-    }
 
-    if (debugSymbols) {
-        compilerLine.add("/Zi /DEBUG ");
-    }
+    settings.debugSymbols = project->debugSymbols;
+    if (configuration->debugSymbolsSet) settings.debugSymbols = configuration->debugSymbols;
+    settings.optimize = project->optimize;
+    if (configuration->optimizeSet) settings.optimize = configuration->optimize;
+    settings.staticRuntime = project->staticRuntime;
+    if (configuration->staticRuntimeSet) settings.staticRuntime = configuration->staticRuntime;
+    settings.runtimeType = project->runtimeType;
 
     if (pchheader && !pchsource) {
         fprintf(stderr, "pchheader set, but pchsource isn't\n");
@@ -279,216 +766,529 @@ void executeMSVCForProject(RscProject *project, RscConfiguration *configuration,
         exit(1);
     }
 
-    DynamicArray<char *> includeDirs;
-    for (int i = 0; i < project->includeDirs.count; i++) {
-        char *dir = project->includeDirs[i];
-        includeDirs.add(dir);
-    }
-    for (int i = 0; i < configuration->includeDirs.count; i++) {
-        char *dir = configuration->includeDirs[i];
-        includeDirs.add(dir);
-    }
-    
-    DynamicArray<char *> libDirs;
     for (int i = 0; i < project->libDirs.count; i++) {
         char *dir = project->libDirs[i];
-        libDirs.add(dir);
+        settings.libDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
     }
     for (int i = 0; i < configuration->libDirs.count; i++) {
         char *dir = configuration->libDirs[i];
-        libDirs.add(dir);
+        settings.libDirs.add(doMacroSubstitutions(dir, project, configuration)); // @Leak
     }
 
-    DynamicArray<char *> libs;
     for (int i = 0; i < project->libs.count; i++) {
-        char *dir = project->libs[i];
-        libs.add(dir);
+        settings.libs.add(project->libs[i]);
     }
     for (int i = 0; i < configuration->libs.count; i++) {
-        char *dir = configuration->libs[i];
-        libs.add(dir);
+        settings.libs.add(configuration->libs[i]);
     }
 
-    DynamicArray<char *> defines;
     for (int i = 0; i < project->defines.count; i++) {
-        char *dir = project->defines[i];
-        defines.add(dir);
+        settings.defines.add(project->defines[i]);
     }
     for (int i = 0; i < configuration->defines.count; i++) {
-        char *dir = configuration->defines[i];
-        defines.add(dir);
+        settings.defines.add(configuration->defines[i]);
     }
-    
-    for (int i = 0; i < includeDirs.count; i++) {
-        char *dir = includeDirs[i];
-        replaceForwardslashWithBackslash(dir);
+
+    CommandLine compilerLine;
+    toolchain->addCompileFlags(&settings, &compilerLine);
+
+    // The .pch only depends on what's on the command line so far, except for
+    // where the objects go, and on which header and source it's made from.
+    // Projects that agree on all of that use the one built first.
+    SharedPch *sharedPch = NULL;
+    Hash128 pchShareKey = {};
+    if (pchsource && pchheader) {
+        HashBuilder builder;
+        for (int i = 0; i < compilerLine.args.count; i++) {
+            if (startsWith(compilerLine.args[i], "/Fo")) continue;
+            builder.add(compilerLine.args[i]);
+        }
+        builder.add(pchheader);
+        char *normalizedPchsource = copyNormalizedPath(pchsource);
+        builder.add(normalizedPchsource);
+        delete[] normalizedPchsource;
         
-        dir = doMacroSubstitutions(dir, project, configuration); // @Leak
-        compilerLine.printf("/I %s ", dir);
-    }
-    
-    compilerLine.printf("/Fo\"%s\\\\\" ", objdir);
-    compilerLine.printf("/Fd\"%s\\\\\" ", outputdir); // Make the .pdb file go into the output directory
-    
-    for (int i = 0; i < defines.count; i++) {
-        char *define = defines[i];
-        compilerLine.printf("/D%s ", define);
+        pchShareKey = builder.state;
+        sharedPch = findSharedPch(pchShareKey);
     }
 
+    // Everything up to here is the same for every file of the project.
+    char *compilerResponseFile = moveToResponseFile(toolchain, &compilerLine, 1, mprintf("%s\\%s.rsp", objdir, toolchain->compiler)); // @Leak
+
+    CommandLine *pchLine = new CommandLine(); // @Leak
+    char *pchPath = toolchain->getPchPath(outputdir, project->name); // @Leak
+    if (sharedPch) pchPath = sharedPch->pchPath;
     if (pchsource && pchheader) {
-        compilerLine.printf("/Fp%s\\%s.pch ", outputdir, project->name);
+        pchLine->copyFrom(&compilerLine);
+        toolchain->addPchCreate(pchLine, pchheader, pchsource, pchPath);
+        toolchain->addPchUse(&compilerLine, pchheader, pchPath);
+    }
+
+    // Every translation unit is compared against its own object file, so a
+    // failed link or a touched header only recompiles the objects that are
+    // actually older than their inputs.
+    //
+    // With --content-hash the modtimes are only a first filter: an object
+    // that looks out of date is still kept if the contents of everything it
+    // was compiled from hash the same as last time, which is what happens
+    // after a checkout or a cache restore touched files without changing them.
+    DynamicArray<char *> filesToCompile;
+    DynamicArray<char *> objectsToCompile;
+    bool needsLink = exeModtime == 0 || rscModtime > exeModtime;
+
+    // The precompiled header is an output of its own. It's only rebuilt when
+    // the header or anything it includes changed, or the flags it's built
+    // with, and only then do the translation units using it have to follow.
+    char *pchObjectPath = NULL;
+    u64 pchObjectModtime = 0;
+    Hash128 pchFlagsHash = {};
+    bool pchStale = false;
+    if (sharedPch) {
+        pchObjectPath = sharedPch->objectPath;
+        pchObjectModtime = sharedPch->objectModtime;
+        pchStale = sharedPch->stale;
+        if (pchStale) pchBuildsAvoided++;
+    } else if (pchsource) {
+        // Without an object of its own the .pch is what gets checked.
+        pchObjectPath = pchPath;
+        if (toolchain->pchHasObject) pchObjectPath = getObjectPath(toolchain, objdir, pchsource); // @Leak
+        u64 pchObjectSize = 0;
+        os::getFileInfo(pchObjectPath, &pchObjectModtime, &pchObjectSize);
+
+        u64 pchModtime = 0;
+        os::getLastWriteTime(pchPath, &pchModtime);
+        
+        HashBuilder builder;
+        builder.add(pchLine->toString()); // @Leak
+        if (compilerResponseFile) builder.add(compilerResponseFile);
+        pchFlagsHash = builder.state;
         
-        StringBuilder pchLine;
-        pchLine.copyFrom(&compilerLine);
+        char *staleReason = NULL;
+        if (globalData.rebuild) staleReason = "rebuild requested";
+        else if (pchObjectModtime == 0 || pchModtime == 0) staleReason = "no output";
+        else if (!hashesMatch(pchFlagsHash, depDatabase->getContentHash(pchObjectPath))) staleReason = "flags changed";
+        pchStale = staleReason != NULL;
         
-        pchLine.printf("/Yc\"%s\" %s ", pchheader, pchsource);
+        if (!pchStale) {
+            if (checkCompilerDeps(includeGraph, depDatabase, pchObjectPath, pchObjectModtime, pchObjectSize, pchObjectModtime, &pchStale)) {
+                if (pchStale) staleReason = "dependency changed";
+            } else {
+                char *normalizedPchsource = copyNormalizedPath(pchsource);
+                defer { delete[] normalizedPchsource; };
+                
+                IncludeNode *node = includeGraph->getNode(normalizedPchsource, depDatabase);
+                pchStale = includeGraph->getNewestModtime(node) > pchObjectModtime;
+                if (pchStale) staleReason = "include changed";
+            }
+        }
+        if (pchStale) stats.addStaleFile(pchsource, staleReason);
 
-        system(pchLine.toString()); // @Leak
-  
-        compilerLine.printf("/Yu\"%s\" ", pchheader);
+        sharedPch = new SharedPch(); // @Leak
+        sharedPch->key = pchShareKey;
+        sharedPch->pchPath = pchPath;
+        sharedPch->objectPath = pchObjectPath;
+        sharedPch->objectModtime = pchObjectModtime;
+        sharedPch->stale = pchStale;
+        sharedPch->depDatabase = depDatabase;
+        sharedPchs.add(sharedPch);
     }
     
-    for (int i = 0; i < filesToCompile.count; i++) {
-        char *filename = filesToCompile[i];
-        compilerLine.add(filename);
-        compilerLine.add(' ');
+    // The precompiled header may still be rebuilt, so for now --content-hash
+    // goes by what it was last built from (see getBuiltPchSignature).
+    // Without that list it can't vouch for any file.
+    build->pch = sharedPch;
+    Hash128 pchSignature = {};
+    bool hasPchSignature = true;
+    if (sharedPch && globalData.contentHash) {
+        hasPchSignature = getRecordedSignature(includeGraph, sharedPch->depDatabase, sharedPch->objectPath, &pchSignature);
     }
     
-    StringBuilder linkerLine;
-    {
-        if (project->kind == OutputKind_StaticLib) {
-            linkerLine.add("lib ");
-        } else {
-            linkerLine.add("link ");
+    double scanStartTime = os::getTime();
+    for (int i = 0; i < files.count; i++) {
+        char *filename = files[i];
+
+        char *objectPath = getObjectPath(toolchain, objdir, filename); // @Leak
+        u64 objectModtime = 0;
+        u64 objectSize = 0;
+        os::getFileInfo(objectPath, &objectModtime, &objectSize);
+
+        if (objectModtime > exeModtime) {
+            needsLink = true;
         }
+
+        char *staleReason = NULL;
+        if (globalData.rebuild) staleReason = "rebuild requested";
+        else if (objectModtime == 0) staleReason = "no output";
+        else if (rscModtime > objectModtime) staleReason = "rsc file changed";
+        else if (pchObjectPath && (pchStale || pchObjectModtime > objectModtime)) staleReason = "precompiled header changed";
+        bool stale = staleReason != NULL;
         
-        linkerLine.add("/nologo /MACHINE:X64 ");
-    }
-    
-    if (pchsource) {
-        project->files.add(pchsource);
+        char *normalizedFilename = copyNormalizedPath(filename);
+        defer { delete[] normalizedFilename; };
+        
+        // The exact dependencies the compiler reported last time answer this without
+        // reading a single source file. Only without them do we fall back
+        // to scanning for includes.
+        bool decided = false;
+        if (!stale) {
+            decided = checkCompilerDeps(includeGraph, depDatabase, objectPath, objectModtime, objectSize, objectModtime, &stale);
+            if (stale) staleReason = "dependency changed";
+        }
+        
+        if (!stale && !decided) {
+            IncludeNode *node = includeGraph->getNode(normalizedFilename, depDatabase);
+            if (includeGraph->getNewestModtime(node) > objectModtime) {
+                stale = true;
+                staleReason = "include changed";
+            }
+        }
+
+        // Only what the compiler reported this exact object was compiled from
+        // can vouch for it. Without that list it's rebuilt.
+        Hash128 depsSignature = {};
+        if (stale && globalData.contentHash && !globalData.rebuild && objectModtime && hasPchSignature &&
+            getRecordedSignature(includeGraph, depDatabase, objectPath, &depsSignature)) {
+            if (hashesMatch(getObjectSignature(depsSignature, pchSignature), depDatabase->getContentHash(objectPath))) {
+                stale = false;
+            }
+        }
+
+        if (stale) {
+            stats.addStaleFile(filename, staleReason);
+            filesToCompile.add(filename);
+            objectsToCompile.add(objectPath);
+        }
     }
-    
-    for (int i = 0; i < project->files.count; i++) {
-        char *filename = project->files[i];
 
-        char *dirWithName = copyStripExtension(filename);
-        dirWithName = replaceBackslashWithForwardslash(dirWithName);
-        char *slash = strrchr(dirWithName, '/');
+    trace.addSpan(scanStartTime, os::getTime(), 0, "rsc", "Check dependencies of %s", project->name);
+    stats.addPhaseTime("checkDependencies", scanStartTime, os::getTime());
+
+    if (filesToCompile.count) needsLink = true;
+    build->needsLink = needsLink;
+
+    // One compiler process per translation unit so the scheduler can spread them
+    // over all cores. Objects found in the compile cache are restored
+    // instead of being compiled at all (see prepareCompile).
+    DynamicArray<Job *> compileJobs;
+    for (int i = 0; i < filesToCompile.count; i++) {
+        char *filename = filesToCompile[i];
+
+        CommandLine *commandLine = new CommandLine(); // @Leak
+        commandLine->copyFrom(&compilerLine);
+        toolchain->addSourceFile(commandLine, filename, objectsToCompile[i]);
+
+        CompileAction *action = new CompileAction(); // @Leak
+        action->build = build;
+        action->sourcePath = filename;
+        action->objectPath = objectsToCompile[i];
         
-        StringBuilder name;
-        if (slash) {
-            for (char *at = slash + 1; *at; at++) {
-                name.add(*at);
-            }
-        } else {
-            name.add(dirWithName);
+        if (compileCache.isEnabled()) {
+            HashBuilder builder;
+            builder.add(compileCache.getCompilerIdentity(toolchain->compiler));
+            builder.add(commandLine->toString()); // @Leak
+            if (compilerResponseFile) builder.add(compilerResponseFile);
+            action->directKey = builder.state;
         }
         
-        linkerLine.printf("%s\\%s.obj ", objdir, name.toString()); // @Leak
-    }
-    
-    for (int i = 0; i < libs.count; i++) {
-        char *lib = libs[i];
-        replaceForwardslashWithBackslash(lib);
-        linkerLine.printf("%s ", lib);
+        Job *job = scheduler->add(filename, commandLine);
+        job->category = "compile";
+        job->captureOutput = true;
+        job->prepare = prepareCompile;
+        job->finish = finishCompile;
+        job->userData = action;
+        compileJobs.add(job);
     }
 
-    for (int i = 0; i < libDirs.count; i++) {
-        char *dir = libDirs[i];
-        replaceForwardslashWithBackslash(dir);
+    if (compileJobs.count && globalData.verbose) {
+        printf("Compiler line: %s <file> (%d files, %d jobs)\n", compilerLine.toString(), compileJobs.count, scheduler->maxRunningJobs); // @Leak
+    }
 
-        dir = doMacroSubstitutions(dir, project, configuration); // @Leak
+    if (pchStale && !sharedPch->job) {
+        CompileAction *action = new CompileAction(); // @Leak
+        action->build = build;
+        action->sourcePath = pchsource;
+        action->objectPath = pchObjectPath;
+        action->precompiledHeader = true;
+        action->pchFlagsHash = pchFlagsHash;
         
-        linkerLine.printf("/LIBPATH:\"%s\" ", dir);
+        Job *pchJob = scheduler->add(pchsource, pchLine);
+        pchJob->category = "compile";
+        pchJob->captureOutput = true;
+        pchJob->finish = finishCompile;
+        pchJob->userData = action;
+        sharedPch->job = pchJob;
     }
-    
-    if (debugSymbols && project->kind != OutputKind_StaticLib) {
-        linkerLine.add("/DEBUG ");
+    if (sharedPch && sharedPch->job) {
+        for (int i = 0; i < compileJobs.count; i++) {
+            scheduler->addDependency(compileJobs[i], sharedPch->job);
+        }
     }
     
-    if (project->kind == OutputKind_ConsoleApp) {
-        linkerLine.add("/subsystem:console ");
-    } else if (project->kind == OutputKind_WindowedApp) {
-        linkerLine.add("/subsystem:windows ");
+    DynamicArray<char *> objects;
+    for (int i = 0; i < files.count; i++) {
+        objects.add(getObjectPath(toolchain, objdir, files[i])); // @Leak
     }
-
-    {
-        char *extension = "exe";
-        if (project->kind == OutputKind_StaticLib) {
-            extension = "lib";
-        }
-        linkerLine.printf("/OUT:%s\\%s.%s ", outputdir, outputname, extension);
+    if (pchObjectPath && toolchain->pchHasObject) {
+        objects.add(pchObjectPath);
     }
 
+    CommandLine *linkerLine = new CommandLine(); // @Leak
+    toolchain->addLinkCommand(&settings, objects, build->dependencyLibs, exepath, linkerLine);
+    moveToResponseFile(toolchain, linkerLine, 1, mprintf("%s\\link.rsp", objdir)); // @Leak
+
     char *resourceFile = project->resourceFile;
     if (configuration->resourceFile) resourceFile = configuration->resourceFile;
     
-    char *rcLine = NULL;
-    if (resourceFile) {
-        rcLine = mprintf("rc.exe %s\n", resourceFile);
+    if (resourceFile && toolchain->type != ToolchainType_MSVC) {
+        printf("Warning: resourceFile '%s' is only compiled with the msvc toolchain, ignoring it\n", resourceFile);
+        resourceFile = NULL;
     }
     
-    double rscEndTime = os::getTime();
-    double rscTime = rscEndTime - rscStartTime;
-    
-    double rcStartTime = os::getTime();
-    if (rcLine) {
-        printf("Resource-Compiler line: %s\n", rcLine);
-        int result = system(rcLine);
-//#ifndef _DEBUG
-        if (result != 0) {
-            exit(1);
+    Job *resourceJob = NULL;
+    if (resourceFile) {
+        ResourceAction *action = new ResourceAction(); // @Leak
+        action->build = build;
+        action->resourceFile = resourceFile;
+        action->outputPath = mprintf("%s/resource.res", outputdir); // @Leak
+        
+        CommandLine *rcLine = new CommandLine(); // @Leak
+        rcLine->add("rc.exe");
+        rcLine->add(resourceFile);
+        
+        resourceJob = scheduler->add(resourceFile, rcLine);
+        resourceJob->category = "resource";
+        resourceJob->prepare = prepareResource;
+        resourceJob->finish = finishResource;
+        resourceJob->userData = action;
+        resourceJob->captureOutput = true;
+        
+        linkerLine->add(action->outputPath);
+    }
+
+    Job *linkJob = scheduler->add(exepath, linkerLine);
+    linkJob->category = "link";
+    if (project->kind == OutputKind_StaticLib) linkJob->category = "archive";
+    linkJob->prepare = prepareLink;
+    linkJob->finish = finishLink;
+    linkJob->userData = build;
+    linkJob->captureOutput = true;
+    // A static library is archived as soon as its own objects are ready,
+    // everything else has to wait for the libraries it links against.
+    if (project->kind != OutputKind_StaticLib) {
+        for (int i = 0; i < build->dependencyJobs.count; i++) {
+            scheduler->addDependency(linkJob, build->dependencyJobs[i]);
         }
+    }
+    if (resourceJob) {
+        scheduler->addDependency(linkJob, resourceJob);
+    }
+    for (int i = 0; i < compileJobs.count; i++) {
+        scheduler->addDependency(linkJob, compileJobs[i]);
+    }
+    build->doneJob = linkJob;
+    
+    return build;
+}
+
+enum VisitState {
+    VisitState_NotVisited,
+    VisitState_Visiting,
+    VisitState_Done,
+};
+
+static int findProject(DynamicArray<RscProject *> &projects, char *name) {
+    for (int i = 0; i < projects.count; i++) {
+        if (stringsMatch(projects[i]->name, name)) return i;
+    }
+    return -1;
+}
+
+static void getDependencyNames(RscProject *project, RscConfiguration *configuration, DynamicArray<char *> &names) {
+    for (int i = 0; i < project->dependsOn.count; i++) {
+        addUnique(names, project->dependsOn[i]);
+    }
+    for (int i = 0; i < configuration->dependsOn.count; i++) {
+        addUnique(names, configuration->dependsOn[i]);
+    }
+}
 
-        char *filepathWithoutExtension = copyString(resourceFile);
-        char *t = strrchr(filepathWithoutExtension, '.');
-        if (t) {
-            filepathWithoutExtension[t - filepathWithoutExtension] = 0;
+// Appends index to order after everything it depends on, so the projects
+// can be planned in that order. Fails on unknown names and cycles.
+static bool orderProjects(DynamicArray<RscProject *> &projects, DynamicArray<RscConfiguration *> &configurations,
+                          int index, DynamicArray<VisitState> &states, DynamicArray<int> &order) {
+    if (states[index] == VisitState_Done) return true;
+
+    RscProject *project = projects[index];
+    if (states[index] == VisitState_Visiting) {
+        fprintf(stderr, "Project '%s' depends on itself through dependsOn.\n", project->name);
+        return false;
+    }
+    states[index] = VisitState_Visiting;
+
+    DynamicArray<char *> dependencyNames;
+    getDependencyNames(project, configurations[index], dependencyNames);
+    
+    for (int i = 0; i < dependencyNames.count; i++) {
+        int dependencyIndex = findProject(projects, dependencyNames[i]);
+        if (dependencyIndex < 0) {
+            fprintf(stderr, "Project '%s' depends on '%s', which doesn't exist.\n", project->name, dependencyNames[i]);
+            return false;
         }
         
-        char *srcFilepath = mprintf("%s.res", filepathWithoutExtension);
-        char *dstFilepath = mprintf("%s/resource.res", outputdir);
+        if (!orderProjects(projects, configurations, dependencyIndex, states, order)) return false;
+    }
+
+    states[index] = VisitState_Done;
+    order.add(index);
+    return true;
+}
+
+// All projects share one job graph: every compile can start right away, a
+// static library is archived as soon as its objects are ready and an
+// executable links once its objects and the libraries it needs are done.
+// So one project's link overlaps with other projects' compiles.
+bool executeProjects(DynamicArray<RscProject *> &projects, DynamicArray<RscConfiguration *> &configurations, u64 rscModtime) {
+    // With --watch this runs once per build, and nothing carries over.
+    sharedPchs.count = 0; // @Leak
+    pchBuildsAvoided = 0;
+    rscContentHashComputed = false;
+    console.seenWarnings.release(); // @Leak
+    console.warnings = 0;
+    console.duplicateWarnings = 0;
+    console.errors = 0;
+    compileCache.hits = 0;
+    compileCache.misses = 0;
+    compileCache.stores = 0;
+    
+    JobScheduler scheduler;
+    scheduler.maxRunningJobs = globalData.jobCount;
+    
+    DynamicArray<VisitState> states;
+    for (int i = 0; i < projects.count; i++) {
+        states.add(VisitState_NotVisited);
+    }
+    
+    DynamicArray<int> order;
+    for (int i = 0; i < projects.count; i++) {
+        if (!orderProjects(projects, configurations, i, states, order)) return false;
+    }
+
+    DynamicArray<ProjectBuild *> builds;
+    builds.resize(projects.count);
+    for (int i = 0; i < order.count; i++) {
+        int index = order[i];
+        RscProject *project = projects[index];
+        RscConfiguration *configuration = configurations[index];
         
-        bool success = os::copyFile(srcFilepath, dstFilepath);
-        if (!success) {
-            fprintf(stderr, "Failed to copy '%s' to '%s'\n", srcFilepath, dstFilepath);
-            exit(1);
+        DynamicArray<char *> dependencyNames;
+        getDependencyNames(project, configuration, dependencyNames);
+
+        DynamicArray<ProjectBuild *> dependencies;
+        for (int j = 0; j < dependencyNames.count; j++) {
+            dependencies.add(builds[findProject(projects, dependencyNames[j])]);
         }
         
-        linkerLine.printf("%s ", dstFilepath);
-//#endif
+        double planStartTime = os::getTime();
+        builds[index] = planProject(project, configuration, rscModtime, dependencies, &scheduler);
+        trace.addSpan(planStartTime, os::getTime(), 0, "rsc", "Plan %s", project->name);
+        stats.addPhaseTime("plan", planStartTime, os::getTime());
     }
-    double rcEndTime = os::getTime();
-    double rcTime = rcEndTime - rcStartTime;
+
+    double buildStartTime = os::getTime();
+    double rscTime = buildStartTime - rscStartTime;
     
-    double clStartTime = os::getTime();
-    printf("Compiler line: %s\n", compilerLine.toString()); // @Leak
-    int result = system(compilerLine.toString()); // @Leak
-#ifndef _DEBUG
-    if (result != 0) {
-        os::deleteFile(exepath);
-        exit(1);
+    bool success = scheduler.run();
+    trace.addSpan(buildStartTime, os::getTime(), 0, "rsc", "Run jobs");
+    stats.addPhaseTime("runJobs", buildStartTime, os::getTime());
+    
+    double saveStartTime = os::getTime();
+    lastDepDatabases.count = 0;
+    for (int i = 0; i < builds.count; i++) {
+        DepDatabase *depDatabase = builds[i]->depDatabase;
+        lastDepDatabases.add(depDatabase);
+        
+        // Records of files that were renamed or are no longer included would
+        // otherwise be carried along forever.
+        if (success) depDatabase->prune();
+        if (!depDatabase->save()) {
+            fprintf(stderr, "Failed to write dependency database '%s'\n", depDatabase->filepath);
+        }
     }
-#endif
-    double clEndTime = os::getTime();
-    double clTime = clEndTime - clStartTime;
-
-    double linkerStartTime = os::getTime();
-    printf("Linker line: %s\n", linkerLine.toString()); // @Leak
-    result = system(linkerLine.toString()); // @Leak
-#ifndef _DEBUG
-    if (result != 0) {
-        os::deleteFile(exepath);
-        exit(1);
+    if (compileCache.stores) {
+        compileCache.trim();
     }
-#endif
-    double linkerEndTime = os::getTime();
-    double linkerTime = linkerEndTime - linkerStartTime;
+    trace.addSpan(saveStartTime, os::getTime(), 0, "rsc", "Save dependencies and trim cache");
+    stats.addPhaseTime("save", saveStartTime, os::getTime());
+
+    double buildTime = os::getTime() - buildStartTime;
 
-    printf("Total time: %.4f\n", rscTime + rcTime + clTime + linkerTime);
+    if (console.warnings || console.errors) {
+        printf("%d warning%s", console.warnings, console.warnings == 1 ? "" : "s");
+        if (console.duplicateWarnings) printf(" (and %d repeats not shown)", console.duplicateWarnings);
+        printf(", %d error%s\n", console.errors, console.errors == 1 ? "" : "s");
+    }
+    
+    printf("Total time: %.4f\n", rscTime + buildTime);
     printf("RSC time: %.4f\n", rscTime);
-    printf("Resource-Compiler time: %.4f\n", rcTime);
-    printf("MSVC time: %.4f\n", clTime);
-    printf("Linker time: %.4f\n", linkerTime);
+    printf("Build time: %.4f\n", buildTime);
+
+    if (compileCache.isEnabled()) {
+        printf("Compile cache: %d hits, %d misses, %d stored\n", compileCache.hits, compileCache.misses, compileCache.stores);
+    }
+
+    if (pchBuildsAvoided) {
+        printf("Precompiled header builds avoided by sharing: %d\n", pchBuildsAvoided);
+    }
+
+    if (globalData.reportCount) {
+        scheduler.printReport(globalData.reportCount);
+    }
+
+    if (globalData.verbose) {
+        os::StatCacheCounters statCache = os::getStatCacheCounters();
+        printf("Stat cache: %llu hits, %llu misses (%llu directories listed, %llu files stat'ed)\n",
+               (unsigned long long)statCache.hits, (unsigned long long)statCache.misses,
+               (unsigned long long)statCache.directoriesListed, (unsigned long long)statCache.filesStated);
+    }
+
+    return success;
+}
+
+// Every file the dependency databases of the last build list as included by
+// something, which covers the headers the compiler reported as well as the
+// ones found by scanning. The paths belong to the databases.
+void getBuildInputs(DynamicArray<char *> &paths) {
+    for (int i = 0; i < lastDepDatabases.count; i++) {
+        DepDatabase *db = lastDepDatabases[i];
+        for (int j = 0; j < db->records.count; j++) {
+            for (u32 k = 0; k < db->records[j].includeCount; k++) {
+                paths.add(db->getInclude(j, (int)k));
+            }
+        }
+    }
+}
+
+// --header-report walks the include graph of every translation unit the way
+// planning would, but without a dependency database, so every file is
+// scanned and nothing is built.
+bool reportHeaders(DynamicArray<RscProject *> &projects, DynamicArray<RscConfiguration *> &configurations) {
+    HeaderReport report;
+    for (int i = 0; i < projects.count; i++) {
+        RscProject *project = projects[i];
+        RscConfiguration *configuration = configurations[i];
+
+        DynamicArray<char *> includeDirs;
+        DynamicArray<char *> externalIncludeDirs;
+        getIncludeDirs(project, configuration, includeDirs, externalIncludeDirs);
+        IncludeGraph *includeGraph = getIncludeGraph(includeDirs, externalIncludeDirs);
+
+        for (int j = 0; j < project->files.count; j++) {
+            char *normalizedFilename = copyNormalizedPath(project->files[j]);
+            report.addTranslationUnit(includeGraph, includeGraph->getNode(normalizedFilename, NULL));
+            delete[] normalizedFilename;
+        }
+    }
+
+    report.print(globalData.headerReportCount);
+    return true;
 }
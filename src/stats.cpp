@@ -0,0 +1,121 @@
+#include "stats.h"
+#include "utils.h"
+#include "compile_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+Stats stats;
+
+void Stats::addStaleFile(char *path, char *reason) {
+    if (!enabled) return;
+
+    StaleFile file;
+    file.path = copyString(path); // @Leak
+    file.reason = reason;
+    staleFiles.add(file);
+}
+
+void Stats::addPhaseTime(char *name, double start, double end) {
+    if (!enabled) return;
+
+    for (int i = 0; i < phases.count; i++) {
+        if (stringsMatch(phases[i].name, name)) {
+            phases[i].seconds += end - start;
+            return;
+        }
+    }
+
+    PhaseTime phase;
+    phase.name = name;
+    phase.seconds = end - start;
+    phases.add(phase);
+}
+
+static void addCounter(StringBuilder *json, char *name, u64 value) {
+    json->printf(",\"%s\":%llu", name, (unsigned long long)value);
+}
+
+void Stats::print(double totalTime) {
+    os::IoCounters io = os::getIoCounters();
+    io.filesStated -= ioBase.filesStated;
+    io.filesRead -= ioBase.filesRead;
+    io.bytesRead -= ioBase.bytesRead;
+    io.filesMapped -= ioBase.filesMapped;
+    io.bytesMapped -= ioBase.bytesMapped;
+    io.processesStarted -= ioBase.processesStarted;
+    
+    os::StatCacheCounters statCache = os::getStatCacheCounters();
+    statCache.hits -= statCacheBase.hits;
+    statCache.misses -= statCacheBase.misses;
+    statCache.directoriesListed -= statCacheBase.directoriesListed;
+    statCache.filesStated -= statCacheBase.filesStated;
+    
+    IncludeGraphCounters includeGraph = getIncludeGraphCounters();
+    includeGraph.hits -= includeGraphBase.hits;
+    includeGraph.misses -= includeGraphBase.misses;
+    includeGraph.databaseHits -= includeGraphBase.databaseHits;
+    includeGraph.filesScanned -= includeGraphBase.filesScanned;
+    includeGraph.bytesScanned -= includeGraphBase.bytesScanned;
+
+    StringBuilder json;
+    json.printf("{\"version\":1,\"totalTime\":%.6f", totalTime);
+    
+    json.add(",\"phases\":{");
+    for (int i = 0; i < phases.count; i++) {
+        if (i) json.add(',');
+        appendJsonString(&json, phases[i].name);
+        json.printf(":%.6f", phases[i].seconds);
+    }
+    json.add('}');
+
+    addCounter(&json, "filesStated", io.filesStated);
+    addCounter(&json, "filesRead", io.filesRead);
+    addCounter(&json, "bytesRead", io.bytesRead);
+    addCounter(&json, "filesMapped", io.filesMapped);
+    addCounter(&json, "bytesMapped", io.bytesMapped);
+    addCounter(&json, "headersScanned", includeGraph.filesScanned);
+    addCounter(&json, "bytesScanned", includeGraph.bytesScanned);
+    addCounter(&json, "processesSpawned", io.processesStarted);
+    addCounter(&json, "peakRss", os::getPeakMemoryUsage());
+
+    json.add(",\"includeGraph\":{");
+    json.printf("\"hits\":%llu", (unsigned long long)includeGraph.hits);
+    addCounter(&json, "misses", includeGraph.misses);
+    addCounter(&json, "databaseHits", includeGraph.databaseHits);
+    json.add('}');
+
+    json.add(",\"statCache\":{");
+    json.printf("\"hits\":%llu", (unsigned long long)statCache.hits);
+    addCounter(&json, "misses", statCache.misses);
+    addCounter(&json, "directoriesListed", statCache.directoriesListed);
+    addCounter(&json, "filesStated", statCache.filesStated);
+    json.add('}');
+
+    if (compileCache.isEnabled()) {
+        json.add(",\"compileCache\":{");
+        json.printf("\"hits\":%d,\"misses\":%d,\"stores\":%d", compileCache.hits, compileCache.misses, compileCache.stores);
+        json.add('}');
+    }
+
+    json.add(",\"staleFiles\":[");
+    for (int i = 0; i < staleFiles.count; i++) {
+        if (i) json.add(',');
+        json.add("{\"path\":");
+        appendJsonString(&json, staleFiles[i].path);
+        json.add(",\"reason\":");
+        appendJsonString(&json, staleFiles[i].reason);
+        json.add('}');
+    }
+    json.add("]}\n");
+
+    fwrite(json.buffer.data, 1, json.buffer.count, stdout);
+}
+
+void Stats::reset() {
+    staleFiles.count = 0; // @Leak
+    phases.count = 0;
+    ioBase = os::getIoCounters();
+    statCacheBase = os::getStatCacheCounters();
+    includeGraphBase = getIncludeGraphCounters();
+}
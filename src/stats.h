@@ -0,0 +1,44 @@
+#pragma once
+
+#include "defines.h"
+#include "dynamic_array.h"
+#include "os.h"
+#include "include_graph.h"
+
+struct StaleFile {
+    char *path;
+    char *reason;
+};
+
+struct PhaseTime {
+    char *name;
+    double seconds;
+};
+
+// What --stats=json prints at the end of a run: the counters the os layer,
+// the include graph and the caches keep anyway, plus why each file was
+// compiled and where rsc's own time went. Meant for tracking build system
+// overhead over many runs, so it is one JSON object on one line.
+struct Stats {
+    bool enabled = false;
+    DynamicArray<StaleFile> staleFiles;
+    DynamicArray<PhaseTime> phases;
+
+    // What the counters were at the last reset.
+    os::IoCounters ioBase = {};
+    os::StatCacheCounters statCacheBase = {};
+    IncludeGraphCounters includeGraphBase = {};
+
+    // Only recorded when enabled. Reasons are string literals.
+    void addStaleFile(char *path, char *reason);
+    // Times of phases with the same name add up.
+    void addPhaseTime(char *name, double start, double end);
+
+    void print(double totalTime);
+
+    // Starts counting from zero again, for every build in watch mode. Peak
+    // RSS stays the peak of the whole process.
+    void reset();
+};
+
+extern Stats stats;
@@ -25,17 +25,22 @@ void Tokenizer::reportError(char *fmt, ...) {
     fprintf(stderr, "Error in line %d of file '%s': %s\n", lineNumber, filepath, buf);
 }
 
+char Tokenizer::peek(int offset) {
+    if (at + offset >= end) return 0;
+    return at[offset];
+}
+
 void Tokenizer::eatWhitespace() {
     for (;;) {
-        if (at[0] == '\n') {
+        if (peek() == '\n') {
             lineNumber++;
             at++;
-        } else if (isWhitespace(at[0])) {
+        } else if (isWhitespace(peek())) {
             at++;
-        } else if (at[0] == '#') {
+        } else if (peek() == '#') {
             at++;
 
-            while (at[0] && !isEndOfLine(at[0])) {
+            while (peek() && !isEndOfLine(peek())) {
                 at++;
             }
         } else {
@@ -51,8 +56,8 @@ Token Tokenizer::getToken() {
     token.textLength = 1;
     token.text = at;
 
-    switch (at[0]) {
-    case '\0': token.type = TokenType_EOF; at++; break;
+    switch (peek()) {
+    case '\0': token.type = TokenType_EOF; if (at < end) at++; break;
         
     case '(': token.type = TokenType_OpenBrace; at++; break;
     case ')': token.type = TokenType_CloseBrace; at++; break;
@@ -70,8 +75,8 @@ Token Tokenizer::getToken() {
         at++;
         token.text = at;
         
-        while (at[0] && at[0] != '"') {
-            if ((at[0] == '\\') && at[1]) {
+        while (peek() && peek() != '"') {
+            if ((peek() == '\\') && peek(1)) {
                 at++;
             }
             at++;
@@ -80,7 +85,7 @@ Token Tokenizer::getToken() {
         token.type = TokenType_String;
         token.textLength = (i32)(at - token.text);
 
-        if (at[0] == '"') {
+        if (peek() == '"') {
             at++;
         } else {
             reportError("A string should always end with a closing quote");
@@ -88,17 +93,17 @@ Token Tokenizer::getToken() {
     } break;
 
     default: {
-        if (isAlpha(at[0]) || at[0] == '_') {
-            while (isAlpha(at[0]) ||
-                   isNumber(at[0]) ||
-                   at[0] == '_') {
+        if (isAlpha(peek()) || peek() == '_') {
+            while (isAlpha(peek()) ||
+                   isNumber(peek()) ||
+                   peek() == '_') {
                 at++;
             }
 
             token.type = TokenType_Identifier;
             token.textLength = (i32)(at - token.text);
-        } else if (isNumber(at[0])) {
-            while (isNumber(at[0]) && at[0]) {
+        } else if (isNumber(peek())) {
+            while (isNumber(peek()) && peek()) {
                 at++;
             }
 
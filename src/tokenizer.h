@@ -30,13 +30,17 @@ struct Token {
     bool equals(char *match);
 };
 
+// Reads from a buffer that doesn't have to be NUL-terminated, such as a
+// mapped file, and never writes into it.
 struct Tokenizer {
     char *filepath;
     char *at;
+    char *end;
     int lineNumber;
     
-    Tokenizer(char *filepath, char *at) : filepath(filepath), at(at), lineNumber(1) {}
+    Tokenizer(char *filepath, char *at, i64 length) : filepath(filepath), at(at), end(at + length), lineNumber(1) {}
 
+    char peek(int offset = 0); // 0 past the end.
     void eatWhitespace();
     Token getToken();
     bool expectToken(Token *token, TokenType type);
@@ -0,0 +1,444 @@
+#include "toolchain.h"
+#include "compile_cache.h"
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Toolchain msvcToolchain = {ToolchainType_MSVC, "msvc", "cl", "obj", true, true, true};
+static Toolchain gccToolchain = {ToolchainType_GCC, "gcc", "g++", "o", false, false, false};
+static Toolchain clangToolchain = {ToolchainType_Clang, "clang", "clang++", "o", false, false, false};
+
+Toolchain *getToolchain(ToolchainType type) {
+    static Toolchain *detected = NULL;
+
+    if (type == ToolchainType_Auto) {
+        if (!detected) {
+#ifdef OS_WINDOWS
+            detected = &msvcToolchain;
+#else
+            detected = &gccToolchain;
+            char *path = os::findExecutable(gccToolchain.compiler);
+            if (path) {
+                free(path);
+            } else {
+                path = os::findExecutable(clangToolchain.compiler);
+                if (path) {
+                    detected = &clangToolchain;
+                    free(path);
+                }
+            }
+#endif
+            if (globalData.verbose) {
+                printf("Using the %s toolchain\n", detected->name);
+            }
+        }
+        return detected;
+    }
+
+    if (type == ToolchainType_MSVC) return &msvcToolchain;
+    if (type == ToolchainType_Clang) return &clangToolchain;
+    return &gccToolchain;
+}
+
+// A copy of path with the separators this toolchain's tools want.
+static char *copyToolPath(Toolchain *toolchain, char *path) {
+    char *result = copyString(path);
+    char from = toolchain->type == ToolchainType_MSVC ? '/' : '\\';
+    char to = toolchain->type == ToolchainType_MSVC ? '\\' : '/';
+    for (char *at = result; *at; at++) {
+        if (*at == from) *at = to;
+    }
+    return result;
+}
+
+void Toolchain::addPath(CommandLine *line, char *prefix, char *path) {
+    char *toolPath = copyToolPath(this, path);
+    line->printf("%s%s", prefix, toolPath);
+    delete[] toolPath;
+}
+
+static bool endsWith(char *s, char *suffix) {
+    i64 length = getStringLength(s);
+    i64 suffixLength = getStringLength(suffix);
+    return length >= suffixLength && stringsMatch(s + length - suffixLength, suffix);
+}
+
+char *Toolchain::getOutputPath(OutputKind kind, char *outputdir, char *outputname) {
+    if (type == ToolchainType_MSVC) {
+        return mprintf("%s/%s.%s", outputdir, outputname, kind == OutputKind_StaticLib ? "lib" : "exe");
+    }
+
+    if (kind != OutputKind_StaticLib) {
+        return mprintf("%s/%s", outputdir, outputname);
+    }
+
+    // The lib prefix goes in front of the name, not in front of a directory it's in.
+    char *slash = strrchr(outputname, '\\');
+    if (!slash) slash = strrchr(outputname, '/');
+    if (!slash) return mprintf("%s/lib%s.a", outputdir, outputname);
+    return mprintf("%s/%.*slib%s.a", outputdir, (int)(slash + 1 - outputname), outputname, slash + 1);
+}
+
+char *Toolchain::getPchPath(char *outputdir, char *projectName) {
+    switch (type) {
+        case ToolchainType_GCC: {
+            // Used with -include <name>.h, which gcc takes from <name>.h.gch.
+            return mprintf("%s\\%s.h.gch", outputdir, projectName);
+        }
+        default: {
+            return mprintf("%s\\%s.pch", outputdir, projectName);
+        }
+    }
+}
+
+char *Toolchain::getDepfilePath(char *objectPath) {
+    return mprintf("%s.d", objectPath);
+}
+
+void Toolchain::addCompileFlags(BuildSettings *settings, CommandLine *line) {
+    if (type == ToolchainType_MSVC) {
+        char *flags[] = {
+            "cl", "/c", "/nologo", "/W3", "/diagnostics:column", "/WL", "/FC", "/Oi", "/EHsc",
+            "/Zc:strictStrings-", "/std:c++20", "/Zc:strictStrings-", "/D_CRT_SECURE_NO_WARNINGS",
+        };
+        for (int i = 0; i < (int)ArrayCount(flags); i++) {
+            line->add(flags[i]);
+        }
+
+        line->printf("%s%s", settings->staticRuntime ? "/MT" : "/MD", settings->runtimeType == RuntimeType_Debug ? "d" : "");
+
+        if (settings->optimize) {
+            line->add("/O2");
+            line->add("/Ob2");
+        } else {
+            line->add("/Od");
+            line->add("/Ob0");
+        }
+
+        if (settings->debugSymbols) {
+            if (compileCache.isEnabled()) {
+                // Cached objects have to carry their own debug info, a shared .pdb can't be restored.
+                line->add("/Z7");
+            } else {
+                // /FS serializes the writes of the parallel cl processes into the shared .pdb.
+                line->add("/Zi");
+                line->add("/FS");
+            }
+            line->add("/DEBUG");
+        }
+
+        for (int i = 0; i < settings->includeDirs.count; i++) {
+            line->add("/I");
+            addPath(line, "", settings->includeDirs[i]);
+        }
+
+        // Warnings from external headers aren't ours to fix.
+        if (settings->externalIncludeDirs.count) {
+            line->add("/external:W0");
+        }
+        for (int i = 0; i < settings->externalIncludeDirs.count; i++) {
+            line->add("/external:I");
+            addPath(line, "", settings->externalIncludeDirs[i]);
+        }
+
+        line->add("/showIncludes");
+        line->printf("/Fo%s\\", settings->objdir);
+        line->printf("/Fd%s\\", settings->outputdir); // Make the .pdb file go into the output directory
+
+        for (int i = 0; i < settings->defines.count; i++) {
+            line->printf("/D%s", settings->defines[i]);
+        }
+        return;
+    }
+
+    line->add(compiler);
+    line->add("-c");
+    line->add("-Wall");
+    // What /Zc:strictStrings- is for cl: string literals may go into a char *.
+    if (type == ToolchainType_Clang) {
+        line->add("-Wno-writable-strings");
+    } else {
+        line->add("-Wno-write-strings");
+    }
+
+    // The closest thing to cl's debug runtime that doesn't change the ABI.
+    if (settings->runtimeType == RuntimeType_Debug) {
+        line->add("-D_GLIBCXX_ASSERTIONS");
+    }
+
+    if (settings->optimize) {
+        line->add("-O2");
+    } else {
+        line->add("-O0");
+    }
+    if (settings->debugSymbols) {
+        line->add("-g");
+    }
+
+    for (int i = 0; i < settings->includeDirs.count; i++) {
+        line->add("-I");
+        addPath(line, "", settings->includeDirs[i]);
+    }
+
+    // Headers found through -isystem don't warn and don't end up in the depfile.
+    for (int i = 0; i < settings->externalIncludeDirs.count; i++) {
+        line->add("-isystem");
+        addPath(line, "", settings->externalIncludeDirs[i]);
+    }
+
+    for (int i = 0; i < settings->defines.count; i++) {
+        line->printf("-D%s", settings->defines[i]);
+    }
+}
+
+// The language standard goes with each file since a .c file can't take -std=c++20.
+static void addGnuInput(Toolchain *toolchain, CommandLine *line, char *sourcePath, char *outputPath, bool header) {
+    char *dot = strrchr(sourcePath, '.');
+    if (dot && stringsMatch(dot, ".c")) {
+        line->add("-x");
+        line->add("c");
+        line->add("-std=c17");
+    } else {
+        if (header) {
+            line->add("-x");
+            line->add("c++-header");
+        }
+        line->add("-std=c++20");
+    }
+
+    toolchain->addPath(line, "", sourcePath);
+    line->add("-o");
+    toolchain->addPath(line, "", outputPath);
+
+    char *depfilePath = toolchain->getDepfilePath(outputPath);
+    line->add("-MMD");
+    line->add("-MF");
+    toolchain->addPath(line, "", depfilePath);
+    free(depfilePath);
+}
+
+void Toolchain::addPchCreate(CommandLine *line, char *pchheader, char *pchsource, char *pchPath) {
+    if (type == ToolchainType_MSVC) {
+        line->printf("/Fp%s", pchPath);
+        line->printf("/Yc%s", pchheader);
+        line->add(pchsource);
+        return;
+    }
+
+    // pchsource does nothing but include pchheader, so precompiling it as a
+    // header gives the same result as with cl.
+    addGnuInput(this, line, pchsource, pchPath, true);
+}
+
+void Toolchain::addPchUse(CommandLine *line, char *pchheader, char *pchPath) {
+    switch (type) {
+        case ToolchainType_MSVC: {
+            line->printf("/Fp%s", pchPath);
+            line->printf("/Yu%s", pchheader);
+        } break;
+        case ToolchainType_GCC: {
+            char *includePath = copyStripExtension(pchPath);
+            line->add("-include");
+            addPath(line, "", includePath);
+            delete[] includePath;
+            line->add("-Winvalid-pch");
+        } break;
+        case ToolchainType_Clang: {
+            line->add("-include-pch");
+            addPath(line, "", pchPath);
+        } break;
+        default: break;
+    }
+}
+
+void Toolchain::addSourceFile(CommandLine *line, char *sourcePath, char *objectPath) {
+    if (type == ToolchainType_MSVC) {
+        // /Fo in the shared flags names the object.
+        line->add(sourcePath);
+        return;
+    }
+
+    addGnuInput(this, line, sourcePath, objectPath, false);
+}
+
+// libs are written the way cl wants them, "user32.lib", so a bare name or
+// one with .lib becomes -l, anything that looks like a path is passed as is.
+static void addGnuLib(Toolchain *toolchain, CommandLine *line, char *lib) {
+    bool isPath = strchr(lib, '/') || strchr(lib, '\\') || endsWith(lib, ".a") || endsWith(lib, ".so") || endsWith(lib, ".o");
+    if (isPath) {
+        toolchain->addPath(line, "", lib);
+        return;
+    }
+
+    char *name = copyString(lib);
+    if (endsWith(name, ".lib")) name[getStringLength(name) - 4] = 0;
+    line->printf("-l%s", name);
+    delete[] name;
+}
+
+void Toolchain::addLinkCommand(BuildSettings *settings, DynamicArray<char *> &objects, DynamicArray<char *> &dependencyLibs,
+                               char *outputPath, CommandLine *line) {
+    bool staticLib = settings->kind == OutputKind_StaticLib;
+
+    if (type == ToolchainType_MSVC) {
+        if (staticLib) {
+            line->add("lib");
+        } else {
+            line->add("link");
+        }
+        line->add("/nologo");
+        line->add("/MACHINE:X64");
+
+        for (int i = 0; i < objects.count; i++) {
+            line->add(objects[i]);
+        }
+
+        for (int i = 0; i < settings->libs.count; i++) {
+            addPath(line, "", settings->libs[i]);
+        }
+
+        // A static library doesn't take in the ones it depends on, they all end
+        // up on the command line of whatever finally links an executable.
+        if (!staticLib) {
+            for (int i = 0; i < dependencyLibs.count; i++) {
+                addPath(line, "", dependencyLibs[i]);
+            }
+        }
+
+        for (int i = 0; i < settings->libDirs.count; i++) {
+            addPath(line, "/LIBPATH:", settings->libDirs[i]);
+        }
+
+        if (settings->debugSymbols && !staticLib) {
+            line->add("/DEBUG");
+        }
+
+        if (settings->kind == OutputKind_ConsoleApp) {
+            line->add("/subsystem:console");
+        } else if (settings->kind == OutputKind_WindowedApp) {
+            line->add("/subsystem:windows");
+        }
+
+        addPath(line, "/OUT:", outputPath);
+        return;
+    }
+
+    if (staticLib) {
+        line->add("ar");
+        line->add("rcs");
+        addPath(line, "", outputPath);
+        for (int i = 0; i < objects.count; i++) {
+            addPath(line, "", objects[i]);
+        }
+        return;
+    }
+
+    // The linker only takes from an archive what the inputs before it need, so
+    // the libraries go after the objects, the ones we build first since those
+    // are what use the others.
+    line->add(compiler);
+    for (int i = 0; i < objects.count; i++) {
+        addPath(line, "", objects[i]);
+    }
+    for (int i = 0; i < dependencyLibs.count; i++) {
+        addPath(line, "", dependencyLibs[i]);
+    }
+
+    for (int i = 0; i < settings->libDirs.count; i++) {
+        addPath(line, "-L", settings->libDirs[i]);
+    }
+    for (int i = 0; i < settings->libs.count; i++) {
+        addGnuLib(this, line, settings->libs[i]);
+    }
+
+    if (settings->staticRuntime) {
+        line->add("-static-libstdc++");
+        line->add("-static-libgcc");
+    }
+
+    line->add("-o");
+    addPath(line, "", outputPath);
+}
+
+void Toolchain::appendResponseFileArgument(StringBuilder *builder, char *arg) {
+    if (type == ToolchainType_MSVC) {
+        appendWindowsArgument(builder, arg);
+        return;
+    }
+
+    // gcc, clang and ar split @files like a shell without expansions, a
+    // backslash escapes whatever comes after it.
+    for (char *at = arg; *at; at++) {
+        if (isWhitespace(*at) || *at == '\\' || *at == '"' || *at == '\'') {
+            builder->add('\\');
+        }
+        builder->add(*at);
+    }
+}
+
+bool readDepfile(char *path, DynamicArray<char *> &deps) {
+    i64 length = 0;
+    char *contents = (char *)os::readEntireFile(path, &length);
+    if (!contents) return false;
+    defer { free(contents); };
+
+    bool inTarget = true;
+    StringBuilder word;
+
+    char *at = contents;
+    char *end = contents + length;
+    while (at < end) {
+        char c = *at;
+
+        if (c == '\\' && at + 1 < end) {
+            char next = at[1];
+            if (next == '\n' || (next == '\r' && at + 2 < end && at[2] == '\n')) {
+                // A line continuation separates words like any whitespace.
+                at += next == '\n' ? 2 : 3;
+                c = ' ';
+            } else if (next == ' ' || next == '#') {
+                word.add(next);
+                at += 2;
+                continue;
+            } else {
+                // Windows paths keep their backslashes.
+                word.add(c);
+                at++;
+                continue;
+            }
+        } else if (c == '$' && at + 1 < end && at[1] == '$') {
+            word.add('$');
+            at += 2;
+            continue;
+        } else {
+            at++;
+        }
+
+        // A colon ends the target unless it's the one in a drive letter.
+        if (c == ':' && inTarget && (at == end || isWhitespace(*at))) {
+            inTarget = false;
+            word.buffer.count = 0;
+            continue;
+        }
+
+        if (isWhitespace(c)) {
+            if (!inTarget && word.buffer.count) {
+                deps.add(word.toString());
+            }
+            word.buffer.count = 0;
+
+            // Only the first rule matters, -MP would add empty ones for the headers.
+            if (c == '\n' && !inTarget) break;
+            continue;
+        }
+
+        word.add(c);
+    }
+
+    if (!inTarget && word.buffer.count) {
+        deps.add(word.toString());
+    }
+    return !inTarget;
+}
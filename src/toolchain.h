@@ -0,0 +1,74 @@
+#pragma once
+
+#include "main.h"
+#include "utils.h"
+
+// What a project's compile and link lines are made from, with the
+// configuration's settings already applied on top of the project's.
+struct BuildSettings {
+    OutputKind kind = OutputKind_ConsoleApp;
+    bool optimize = false;
+    bool debugSymbols = false;
+    bool staticRuntime = false;
+    RuntimeType runtimeType = RuntimeType_Debug;
+
+    char *objdir = NULL;
+    char *outputdir = NULL;
+
+    DynamicArray<char *> defines;
+    DynamicArray<char *> includeDirs;
+    DynamicArray<char *> externalIncludeDirs;
+    DynamicArray<char *> libDirs;
+    DynamicArray<char *> libs;
+};
+
+// The command line syntax of one compiler family. Paths are passed in the
+// way the rest of rsc keeps them and come out with the separators the tools
+// expect.
+struct Toolchain {
+    ToolchainType type;
+    char *name;
+
+    char *compiler; // Also what the compile cache identifies the compiler by.
+    char *objectExtension;
+
+    // cl's /Yc makes an object next to the .pch that has to be linked in.
+    bool pchHasObject;
+    // cl prints the name of every file it compiles, the others print nothing.
+    bool echoesSourceName;
+    // cl reports the headers it opens in its output with /showIncludes, the
+    // others write them to the depfile next to the object.
+    bool reportsIncludesInOutput;
+
+    char *getOutputPath(OutputKind kind, char *outputdir, char *outputname);
+    char *getPchPath(char *outputdir, char *projectName);
+    char *getDepfilePath(char *objectPath);
+
+    // Adds prefix followed by path as one argument.
+    void addPath(CommandLine *line, char *prefix, char *path);
+
+    // The flags every file of a project is compiled with.
+    void addCompileFlags(BuildSettings *settings, CommandLine *line);
+
+    // Turn the shared flags into the line that builds the precompiled
+    // header, or into one that uses it.
+    void addPchCreate(CommandLine *line, char *pchheader, char *pchsource, char *pchPath);
+    void addPchUse(CommandLine *line, char *pchheader, char *pchPath);
+
+    void addSourceFile(CommandLine *line, char *sourcePath, char *objectPath);
+
+    // Archives a static library or links an executable.
+    void addLinkCommand(BuildSettings *settings, DynamicArray<char *> &objects, DynamicArray<char *> &dependencyLibs,
+                        char *outputPath, CommandLine *line);
+
+    // Quoted the way the tools split up their @response files.
+    void appendResponseFileArgument(StringBuilder *builder, char *arg);
+};
+
+// ToolchainType_Auto is MSVC on Windows and otherwise GCC, or Clang when
+// there is no g++.
+Toolchain *getToolchain(ToolchainType type);
+
+// Reads the prerequisites of the first rule of a make style depfile, as
+// written by -MMD. The paths are malloc'ed.
+bool readDepfile(char *path, DynamicArray<char *> &deps);
@@ -0,0 +1,91 @@
+#include "trace.h"
+#include "os.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+Trace trace;
+
+char *mprintf_valist(char *fmt, va_list args);
+
+void Trace::addSpan(double start, double end, int lane, char *category, char *fmt, ...) {
+    if (!enabled) return;
+
+    va_list args;
+    va_start(args, fmt);
+    char *name = mprintf_valist(fmt, args); // @Leak
+    va_end(args);
+
+    TraceEvent event = {};
+    event.name = name;
+    event.category = category;
+    event.phase = 'X';
+    event.start = start;
+    event.end = end;
+    event.lane = lane;
+    events.add(event);
+
+    if (lane >= laneCount) laneCount = lane + 1;
+}
+
+void Trace::addCounter(char *name, double time, i64 value) {
+    if (!enabled) return;
+
+    TraceEvent event = {};
+    event.name = name;
+    event.category = "counter";
+    event.phase = 'C';
+    event.start = time;
+    event.end = time;
+    event.value = value;
+    events.add(event);
+}
+
+void Trace::reset() {
+    events.count = 0; // @Leak
+    laneCount = 1;
+}
+
+bool Trace::write(char *filepath) {
+    // Timestamps are microseconds from the first event.
+    double origin = 0.0;
+    for (int i = 0; i < events.count; i++) {
+        if (i == 0 || events[i].start < origin) origin = events[i].start;
+    }
+
+    StringBuilder json;
+    json.add("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for (int lane = 0; lane < laneCount; lane++) {
+        if (lane > 0) json.add(",\n");
+        json.printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", lane);
+        if (lane == 0) {
+            appendJsonString(&json, "rsc");
+        } else {
+            char *laneName = mprintf("Job slot %d", lane);
+            appendJsonString(&json, laneName);
+            free(laneName);
+        }
+        json.add("}}");
+    }
+
+    for (int i = 0; i < events.count; i++) {
+        TraceEvent &event = events[i];
+        double start = (event.start - origin) * 1000000.0;
+
+        json.add(",\n{\"name\":");
+        appendJsonString(&json, event.name);
+        json.add(",\"cat\":");
+        appendJsonString(&json, event.category);
+        if (event.phase == 'X') {
+            json.printf(",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.lane, start, (event.end - event.start) * 1000000.0);
+        } else {
+            json.printf(",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%lld}}", start, (long long)event.value);
+        }
+    }
+
+    json.add("\n]}\n");
+    return os::writeEntireFile(filepath, json.buffer.data, json.buffer.count);
+}
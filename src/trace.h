@@ -0,0 +1,35 @@
+#pragma once
+
+#include "defines.h"
+#include "dynamic_array.h"
+
+struct TraceEvent {
+    char *name;
+    char *category;
+    char phase;   // 'X' for a span, 'C' for a counter.
+    double start; // os::getTime() seconds.
+    double end;
+    int lane;
+    i64 value;    // Counters only.
+};
+
+// Records where a build's time goes for --trace=<file>, written out as
+// Chrome trace event JSON that chrome://tracing and Perfetto open. Lane 0
+// is rsc itself, lanes from 1 on are the slots jobs run in. Nothing is
+// recorded unless enabled.
+struct Trace {
+    bool enabled = false;
+    DynamicArray<TraceEvent> events;
+    int laneCount = 1;
+
+    // The name is formatted and copied only when enabled.
+    void addSpan(double start, double end, int lane, char *category, char *fmt, ...);
+    void addCounter(char *name, double time, i64 value);
+
+    bool write(char *filepath);
+
+    // Starts over for the next build of --watch, which writes its own trace.
+    void reset();
+};
+
+extern Trace trace;
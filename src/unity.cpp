@@ -0,0 +1,180 @@
+#include "unity.h"
+#include "main.h"
+#include "hash.h"
+#include "hash_table.h"
+#include "os.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// C files would be compiled as C++ inside a .cpp batch.
+static bool isBatchable(char *filename) {
+    char *dot = strrchr(filename, '.');
+    if (!dot) return false;
+    return stringsMatch(dot, ".cpp") || stringsMatch(dot, ".cc") || stringsMatch(dot, ".cxx");
+}
+
+static int comparePaths(const void *a, const void *b) {
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+// What the #includes in objdir put in front of a source path to get back to
+// it. Relative where possible, so the generated files, and the compile
+// cache keys that hash them, don't depend on where the checkout lives.
+static char *getSourcePrefix(char *objdir) {
+    char *normalized = copyNormalizedPath(objdir);
+    defer { delete[] normalized; };
+
+    bool absolute = normalized[0] == '/' || (normalized[0] && normalized[1] == ':');
+    if (absolute || startsWith(normalized, "..")) {
+        char *cwd = os::getCurrentDirectory();
+        if (!cwd) {
+            fprintf(stderr, "Failed to get the current directory\n");
+            exit(1);
+        }
+        char *normalizedCwd = copyNormalizedPath(cwd);
+        char *prefix = mprintf("%s/", normalizedCwd);
+        delete[] normalizedCwd;
+        free(cwd);
+        return prefix;
+    }
+
+    StringBuilder prefix;
+    if (!stringsMatch(normalized, ".")) {
+        prefix.add("../");
+        for (char *at = normalized; *at; at++) {
+            if (*at == '/') prefix.add("../");
+        }
+    }
+    return prefix.toString();
+}
+
+void planUnityBuild(DynamicArray<char *> &files, DynamicArray<char *> &exclude, int batchSize,
+                    char *objdir, char *objectExtension, char *pchheader, bool rebuild, DynamicArray<char *> &result) {
+    StringTable<bool> excluded;
+    for (int i = 0; i < exclude.count; i++) {
+        *excluded.add(copyNormalizedPath(exclude[i])) = true; // @Leak
+    }
+
+    // Files that were taken out of their batch on an earlier run.
+    char *isolatedListPath = mprintf("%s\\unity.isolated", objdir);
+    defer { free(isolatedListPath); };
+
+    StringTable<bool> wasIsolated;
+    char *isolatedList = rebuild ? NULL : (char *)os::readEntireFile(isolatedListPath);
+    defer { if (isolatedList) free(isolatedList); };
+    if (isolatedList) {
+        char *cursor = isolatedList;
+        while (char *line = consumeNextLine(&cursor)) {
+            if (line[0]) *wasIsolated.add(line) = true;
+        }
+    }
+
+    DynamicArray<char *> batchable;
+    for (int i = 0; i < files.count; i++) {
+        char *filename = files[i];
+        char *normalized = copyNormalizedPath(filename); // @Leak
+
+        if (!isBatchable(filename) || excluded.find(normalized)) {
+            result.add(filename);
+        } else {
+            batchable.add(normalized);
+        }
+    }
+    qsort(batchable.data, batchable.count, sizeof(char *), comparePaths);
+
+    // A batch ends after a file whose path hashes to 0 modulo cutDivisor, but
+    // not before it has minimumSize files and never past twice batchSize.
+    // On average that makes batchSize files.
+    int minimumSize = batchSize / 2;
+    if (minimumSize < 1) minimumSize = 1;
+    u64 cutDivisor = (u64)(batchSize - minimumSize + 1);
+    int maximumSize = batchSize * 2;
+
+    char *sourcePrefix = getSourcePrefix(objdir);
+    defer { free(sourcePrefix); };
+
+    StringBuilder isolatedListBuilder;
+    int batchCount = 0;
+    int batchedCount = 0;
+    int isolatedCount = 0;
+
+    DynamicArray<char *> batch;
+    DynamicArray<char *> members;
+    for (int i = 0; i < batchable.count; i++) {
+        batch.add(batchable[i]);
+
+        bool last = i == batchable.count - 1;
+        bool cut = batch.count >= maximumSize ||
+            (batch.count >= minimumSize && hashString(batchable[i]) % cutDivisor == 0);
+        if (!cut && !last) continue;
+
+        // Named after the first file, which only changes when the cut before
+        // it moves, so taking files out doesn't rename the batch.
+        u64 name = hashString(batch[0]);
+        char *unityPath = mprintf("%s\\unity_%016llx.cpp", objdir, (unsigned long long)name); // @Leak
+        char *unityObjectPath = mprintf("%s\\unity_%016llx.%s", objdir, (unsigned long long)name, objectExtension);
+        defer { free(unityObjectPath); };
+
+        u64 objectModtime = 0;
+        if (!rebuild) os::getLastWriteTime(unityObjectPath, &objectModtime);
+
+        members.count = 0;
+        for (int j = 0; j < batch.count; j++) {
+            char *member = batch[j];
+
+            bool isolated = objectModtime && wasIsolated.find(member);
+            if (!isolated && objectModtime) {
+                os::FileInfo info;
+                isolated = os::getCachedFileInfo(member, &info) && info.modtime > objectModtime;
+            }
+
+            if (isolated) {
+                result.add(member);
+                isolatedListBuilder.add(member);
+                isolatedListBuilder.add('\n');
+                isolatedCount++;
+            } else {
+                members.add(member);
+            }
+        }
+
+        if (members.count == 1) {
+            result.add(members[0]);
+        } else if (members.count > 1) {
+            StringBuilder unity;
+            unity.add("// Generated by rsc for a unity build.\n");
+            if (pchheader) {
+                // With /Yu everything up to this line comes from the .pch.
+                unity.printf("#include \"%s\"\n", pchheader);
+            }
+            for (int j = 0; j < members.count; j++) {
+                char *member = members[j];
+                bool absolute = member[0] == '/' || member[1] == ':';
+                unity.printf("#include \"%s%s\"\n", absolute ? "" : sourcePrefix, member);
+            }
+
+            if (!writeFileIfChanged(unityPath, unity.buffer.data, unity.buffer.count)) {
+                fprintf(stderr, "Failed to write unity file '%s'\n", unityPath);
+                exit(1);
+            }
+
+            result.add(unityPath);
+            batchCount++;
+            batchedCount += members.count;
+        }
+
+        batch.count = 0;
+    }
+
+    if (!writeFileIfChanged(isolatedListPath, isolatedListBuilder.buffer.data, isolatedListBuilder.buffer.count)) {
+        fprintf(stderr, "Failed to write '%s'\n", isolatedListPath);
+        exit(1);
+    }
+
+    if (globalData.verbose) {
+        printf("Unity build: %d files in %d batches, %d edited files on their own\n", batchedCount, batchCount, isolatedCount);
+    }
+}
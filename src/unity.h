@@ -0,0 +1,18 @@
+#pragma once
+
+#include "dynamic_array.h"
+
+// Turns the files of a project into the list of translation units to
+// compile for a unity build. C++ files that aren't excluded are put into
+// batches of about batchSize, each compiled through a generated
+// objdir\unity_<hash>.cpp that includes its files, the rest are passed
+// through as they are.
+//
+// Batches are cut where the hash of a file's path says so rather than every
+// batchSize files, so adding or removing a file only changes the batch it
+// falls into. A file edited since its batch was last compiled is taken out
+// of the batch and compiled on its own from then on, so working on it
+// doesn't recompile its whole batch each time. Isolated files go back into
+// their batches on a full rebuild.
+void planUnityBuild(DynamicArray<char *> &files, DynamicArray<char *> &exclude, int batchSize,
+                    char *objdir, char *objectExtension, char *pchheader, bool rebuild, DynamicArray<char *> &result);
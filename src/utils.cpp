@@ -1,5 +1,7 @@
 #include "utils.h"
+#include "os.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
@@ -30,7 +32,7 @@ char *copyStringLowercased(char *s) {
     result[length] = 0;
     
     for (i64 i = 0; i < length; i++) {
-        s[i] = tolower(s[i]);
+        result[i] = tolower(s[i]);
     }
     
     return result;
@@ -45,6 +47,53 @@ char *copyStripExtension(char *filename) {
     return result;
 }
 
+// Forward slashes only, no "." components, and ".." folded into the
+// preceding directory where there is one, so the same file always ends up
+// with the same name.
+char *copyNormalizedPath(char *path) {
+    i64 length = getStringLength(path);
+    char *result = new char[length + 1];
+
+    i64 count = 0;
+    char *at = path;
+    while (*at) {
+        char *start = at;
+        while (*at && *at != '/' && *at != '\\') at++;
+        i64 partLength = at - start;
+        bool hadSeparator = *at != 0;
+        if (*at) at++;
+
+        if (partLength == 0) {
+            // A leading slash is kept, doubled slashes are dropped.
+            if (start == path && hadSeparator) result[count++] = '/';
+            continue;
+        }
+        if (partLength == 1 && start[0] == '.') continue;
+
+        if (partLength == 2 && start[0] == '.' && start[1] == '.') {
+            i64 previous = count;
+            if (previous > 0 && result[previous - 1] == '/') previous--;
+            i64 partStart = previous;
+            while (partStart > 0 && result[partStart - 1] != '/') partStart--;
+
+            bool previousIsParent = (previous - partStart == 2 &&
+                                     result[partStart] == '.' && result[partStart + 1] == '.');
+            if (previous > partStart && !previousIsParent) {
+                count = partStart;
+                continue;
+            }
+        }
+
+        if (count > 0 && result[count - 1] != '/') result[count++] = '/';
+        memcpy(result + count, start, partLength);
+        count += partLength;
+    }
+
+    if (count == 0) result[count++] = '.';
+    result[count] = 0;
+    return result;
+}
+
 bool stringsMatch(char *a, char *b) {
     if (a == b) return true;
     if (!a || !b) return false;
@@ -144,13 +193,25 @@ char *mprintf(char *fmt, ...) {
     return str;
 }
 
+bool writeFileIfChanged(char *filepath, void *data, i64 length) {
+    i64 existingLength = 0;
+    char *existing = (char *)os::readEntireFile(filepath, &existingLength);
+    if (existing) {
+        bool unchanged = existingLength == length && memcmp(existing, data, length) == 0;
+        free(existing);
+        if (unchanged) return true;
+    }
+
+    return os::writeEntireFile(filepath, data, length);
+}
+
 char *mprintf_valist(char *fmt, va_list args) {
-    va_list ap = args;
+    va_list ap;
+    va_copy(ap, args);
     size_t n = 1 + vsnprintf(NULL, 0, fmt, ap);
     va_end(ap);
     char *str = (char *)malloc(n);
     vsnprintf(str, n, fmt, args);
-    va_end(args);
     return str;
 }
 
@@ -185,3 +246,89 @@ void StringBuilder::add(char c) {
 char *StringBuilder::toString() {
     return toCString(buffer.data, buffer.count);
 }
+
+void CommandLine::copyFrom(CommandLine *other) {
+    for (int i = 0; i < other->args.count; i++) {
+        args.add(other->args[i]);
+    }
+}
+
+void CommandLine::add(char *arg) {
+    args.add(copyString(arg)); // @Leak
+}
+
+void CommandLine::printf(char *fmt, ...) {
+    va_list list;
+    va_start(list, fmt);
+    args.add(mprintf_valist(fmt, list)); // @Leak
+    va_end(list);
+}
+
+char **CommandLine::getArgv() {
+    args.reserve(args.count + 1);
+    args.data[args.count] = NULL;
+    return args.data;
+}
+
+char *CommandLine::toString() {
+    StringBuilder builder;
+    for (int i = 0; i < args.count; i++) {
+        char *arg = args[i];
+        if (i) builder.add(' ');
+        
+        if (strchr(arg, ' ') || !arg[0]) {
+            builder.printf("\"%s\"", arg);
+        } else {
+            builder.add(arg);
+        }
+    }
+    return builder.toString();
+}
+
+void appendWindowsArgument(StringBuilder *builder, char *arg) {
+    bool needsQuotes = arg[0] == 0;
+    for (char *at = arg; *at; at++) {
+        if (*at == ' ' || *at == '\t' || *at == '"') needsQuotes = true;
+    }
+    if (!needsQuotes) {
+        builder->add(arg);
+        return;
+    }
+
+    builder->add('"');
+    for (char *at = arg;; at++) {
+        int backslashes = 0;
+        while (*at == '\\') {
+            backslashes++;
+            at++;
+        }
+
+        // Backslashes are only special right before a quote.
+        if (*at == 0) {
+            for (int i = 0; i < backslashes * 2; i++) builder->add('\\');
+            break;
+        } else if (*at == '"') {
+            for (int i = 0; i < backslashes * 2 + 1; i++) builder->add('\\');
+        } else {
+            for (int i = 0; i < backslashes; i++) builder->add('\\');
+        }
+        builder->add(*at);
+    }
+    builder->add('"');
+}
+
+void appendJsonString(StringBuilder *builder, char *s) {
+    builder->add('"');
+    for (char *at = s; *at; at++) {
+        unsigned char c = (unsigned char)*at;
+        if (c == '"' || c == '\\') {
+            builder->add('\\');
+            builder->add((char)c);
+        } else if (c < 0x20) {
+            builder->printf("\\u%04x", c);
+        } else {
+            builder->add((char)c);
+        }
+    }
+    builder->add('"');
+}
@@ -7,6 +7,7 @@ i64 getStringLength(char *s);
 char *copyString(char *s);
 char *copyStringLowercased(char *s);
 char *copyStripExtension(char *filename);
+char *copyNormalizedPath(char *path);
 bool stringsMatch(char *a, char *b);
 
 bool isEndOfLine(char c);
@@ -20,6 +21,10 @@ bool startsWith(char *a, char *b);
 
 char *mprintf(char *fmt, ...);
 
+// Leaves the file, and with it its modtime, alone if it already has exactly
+// these contents. Otherwise writes it in one go.
+bool writeFileIfChanged(char *filepath, void *data, i64 length);
+
 struct StringBuilder {
     DynamicArray<char> buffer;
 
@@ -32,3 +37,24 @@ struct StringBuilder {
     
     char *toString();
 };
+
+// Arguments for os::startProcess, one per element. Nothing goes through a
+// shell, so nothing in here is ever quoted or escaped.
+struct CommandLine {
+    DynamicArray<char *> args;
+
+    void copyFrom(CommandLine *other);
+
+    void add(char *arg);
+    void printf(char *fmt, ...); // Adds a single argument.
+    
+    char **getArgv(); // NULL-terminated, valid until the next add.
+    char *toString(); // For printing; arguments with spaces come out quoted.
+};
+
+// Quotes arg the way CommandLineToArgvW and the CRT split it up again, which
+// is also how cl and link read response files.
+void appendWindowsArgument(StringBuilder *builder, char *arg);
+
+// s as a quoted and escaped JSON string.
+void appendJsonString(StringBuilder *builder, char *s);
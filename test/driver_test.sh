@@ -0,0 +1,123 @@
+#!/bin/sh
+# Runs build/rsc against the stand-in compiler in test/bin and checks how
+# compiles are scheduled: -j limits how many run at once, a failing compile
+# keeps the link from running, and without -j the job count follows the CPU
+# limit of our cgroup. Build rsc with build.sh first, then run this from anywhere.
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+rsc="$root/build/rsc"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+PATH="$root/test/bin:$PATH"
+export PATH
+unset MAKEFLAGS
+FAKE_CXX_LOG="$work/log"
+export FAKE_CXX_LOG
+
+failures=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok - $1"
+    else
+        echo "FAIL - $1: expected $3, got $2"
+        failures=$((failures + 1))
+    fi
+}
+
+# The most compiles the log shows running at the same time.
+maxConcurrent() {
+    awk '$1 == "start" { print $2, 1 } $1 == "end" { print $2, -1 }' "$FAKE_CXX_LOG" |
+        sort -k1,1n -k2,2n |
+        awk '{ running += $2; if (running > max) max = running } END { print max + 0 }'
+}
+
+# What getProcessorCount in os_posix.cpp should come up with.
+expectedJobCount() {
+    count=$(nproc)
+    limit=0
+
+    cgroup=$(sed -n 's|^0::\(/..*\)$|\1|p' /proc/self/cgroup)
+    cpuMax=/sys/fs/cgroup$cgroup/cpu.max
+    [ -r "$cpuMax" ] || cpuMax=/sys/fs/cgroup/cpu.max
+
+    cfs=$(sed -n 's|^[0-9]*:\([^:]*,\)\{0,1\}cpu\(,[^:]*\)\{0,1\}:\(/..*\)$|\3|p' /proc/self/cgroup)
+    cfsDir=/sys/fs/cgroup/cpu$cfs
+    [ -r "$cfsDir/cpu.cfs_quota_us" ] || cfsDir=/sys/fs/cgroup/cpu
+
+    if [ -r "$cpuMax" ]; then
+        read quota period < "$cpuMax"
+        [ "$quota" != max ] && [ "$quota" -gt 0 ] && limit=$(((quota + period - 1) / period))
+    elif [ -r "$cfsDir/cpu.cfs_quota_us" ]; then
+        quota=$(cat "$cfsDir/cpu.cfs_quota_us")
+        period=$(cat "$cfsDir/cpu.cfs_period_us")
+        [ "$quota" -gt 0 ] && limit=$(((quota + period - 1) / period))
+    fi
+
+    [ "$limit" -gt 0 ] && [ "$limit" -lt "$count" ] && count=$limit
+    echo "$count"
+}
+
+# The job count rsc reports for compiling every file of the project.
+reportedJobCount() {
+    rm -rf "$work/obj" "$work/out"
+    "$rsc" "$work/t.rsc" -configuration:Debug -v | sed -n 's/^Compiler line: .*, \([0-9]*\) jobs)$/\1/p'
+}
+
+cd "$work"
+cat > t.rsc <<'RSC'
+version = 1;
+configurations = { "Debug" };
+project "T" {
+    kind = ConsoleApp;
+    toolchain = gcc;
+    outputdir = "out";
+    objdir = "obj";
+    files = { "a.cpp", "b.cpp", "c.cpp", "d.cpp", "e.cpp", "f.cpp", "g.cpp", "h.cpp" };
+}
+RSC
+for name in a b c d e f g h; do
+    echo "int $name() { return 0; }" > $name.cpp
+done
+
+# -j
+FAKE_CXX_SECONDS=0.3
+export FAKE_CXX_SECONDS
+"$rsc" t.rsc -configuration:Debug -j 3 > /dev/null
+check "-j 3 exits successfully" $? 0
+check "-j 3 runs 3 compiles at once" "$(maxConcurrent)" 3
+check "-j 3 compiles every file" "$(grep -c start "$FAKE_CXX_LOG")" 8
+check "-j 3 links" "$(grep -c link "$FAKE_CXX_LOG")" 1
+
+rm -rf obj out "$FAKE_CXX_LOG"
+"$rsc" t.rsc -configuration:Debug -j 1 > /dev/null
+check "-j 1 runs one compile at a time" "$(maxConcurrent)" 1
+
+# A failing compile.
+rm -rf obj out "$FAKE_CXX_LOG"
+echo "FAKE_CXX_FAIL" >> c.cpp
+"$rsc" t.rsc -configuration:Debug -j 2 > /dev/null
+check "a failed compile fails the build" $? 1
+check "a failed compile keeps the link from running" "$(grep -c link "$FAKE_CXX_LOG")" 0
+check "a failed compile leaves no executable" "$(ls out 2>/dev/null | wc -l)" 0
+echo "int c() { return 0; }" > c.cpp
+
+# The default job count.
+FAKE_CXX_SECONDS=0
+check "without -j as many jobs as the cgroup allows" "$(reportedJobCount)" "$(expectedJobCount)"
+
+# With a cgroup v1 cpu controller we may write to, a quota of one CPU.
+limited=/sys/fs/cgroup/cpu/rsc-driver-test-$$
+if mkdir "$limited" 2> /dev/null; then
+    echo 100000 > "$limited/cpu.cfs_period_us"
+    echo 100000 > "$limited/cpu.cfs_quota_us"
+    rm -rf obj out
+    jobs=$(sh -c "echo \$\$ > '$limited/cgroup.procs' && exec '$rsc' t.rsc -configuration:Debug -v" |
+        sed -n 's/^Compiler line: .*, \([0-9]*\) jobs)$/\1/p')
+    check "without -j one job under a quota of one CPU" "$jobs" 1
+    rmdir "$limited"
+else
+    echo "skip - no cgroup v1 cpu controller to set a quota in"
+fi
+
+[ $failures -eq 0 ]